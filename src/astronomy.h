@@ -3,8 +3,22 @@
 
 #define _USE_MATH_DEFINES
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cfloat>
+#include <vector>
+
+#include "trig.h"
+
+// GCC/Clang在x86等平台上提供__float128，用于可证明正确的日界判断，链接时需要-lquadmath
+// 定义ASTRONOMY_NO_FLOAT128可关闭，不再依赖libquadmath（编译命令见calendar.cpp与chncal.h）
+#if defined(__SIZEOF_FLOAT128__) && !defined(ASTRONOMY_NO_FLOAT128)
+#define ASTRONOMY_HAS_FLOAT128 1
+#include <quadmath.h>
+#else
+#define ASTRONOMY_HAS_FLOAT128 0
+#endif
 
 enum solar_term_t {
     spring_equinox = 0,
@@ -47,6 +61,9 @@ namespace astronomy {
         REAL second;
     };
 
+    // 整数日序，即儒略日数（JDN）：该日正午的儒略日，该日0点的儒略日为day_number - 0.5
+    typedef int day_number_t;
+
     struct ecliptic_position_t {
         REAL longitude, latitude;
     };
@@ -83,7 +100,7 @@ namespace astronomy {
             REAL v = 0;
             for (std::size_t i = 0; i < n; ++i) {
                 const auto &e = c[i];
-                v += e.a * std::cos(e.b + e.c * t);
+                v += e.a * fast_cos(e.b + e.c * t);
             }
             return v;
         }
@@ -92,11 +109,210 @@ namespace astronomy {
             REAL v = 0;
             for (std::size_t i = 0; i < n; ++i) {
                 const auto &e = c[i];
-                v += e.f * std::sin(e.a0 + (e.a1 + (e.a2 + (e.a3 + e.a4 * t) * t) * t) * t);
+                v += e.f * fast_sin(e.a0 + (e.a1 + (e.a2 + (e.a3 + e.a4 * t) * t) * t) * t);
             }
             return v;
         }
 
+        // 低精度档：用double计算，并略去振幅小于cutoff的项，tail累加略去项的振幅，作为截断误差的上界
+        // 保留项的振幅与相位先按块收集，再整块求和，以便向量化
+        static constexpr std::size_t LITE_TERM_BLOCK = 64;
+
+        static double vsop87_periodic_terms_lite(const vsop87_coefficient_t *c, std::size_t n, double t, double cutoff, double &tail) {
+            double a[LITE_TERM_BLOCK], x[LITE_TERM_BLOCK];
+            double v = 0;
+            std::size_t k = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto &e = c[i];
+                if (std::fabs((double)e.a) < cutoff) {
+                    tail += std::fabs((double)e.a);
+                    continue;
+                }
+                a[k] = (double)e.a;
+                x[k] = (double)e.b + (double)e.c * t;
+                if (++k == LITE_TERM_BLOCK) {
+                    v += fast_trig_dot(a, x, k, true);
+                    k = 0;
+                }
+            }
+            return v + fast_trig_dot(a, x, k, true);
+        }
+
+        static double elp2000_periodic_terms_lite(const elp2000_coefficient_t *c, std::size_t n, double t, double cutoff, double &tail) {
+            double a[LITE_TERM_BLOCK], x[LITE_TERM_BLOCK];
+            double v = 0;
+            std::size_t k = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto &e = c[i];
+                if (std::fabs((double)e.f) < cutoff) {
+                    tail += std::fabs((double)e.f);
+                    continue;
+                }
+                a[k] = (double)e.f;
+                x[k] = (double)e.a0 + ((double)e.a1 + ((double)e.a2 + ((double)e.a3 + (double)e.a4 * t) * t) * t) * t;
+                if (++k == LITE_TERM_BLOCK) {
+                    v += fast_trig_dot(a, x, k, false);
+                    k = 0;
+                }
+            }
+            return v + fast_trig_dot(a, x, k, false);
+        }
+
+        // 等间隔网格上的周期项求和：out[k] += Σ a_i·cos(φ_i(t0 + k·h))，sine为true时为sin，k = 0 ~ count-1
+        // coef(i, p)返回第i项的振幅，并把相位多项式（至多4次）的系数填入p[0..4]
+        // 相邻两点的相位差为Δφ_k = δ1 + k·δ2，cos、sin由上一点乘以e^{iΔφ_k}得到，e^{iΔφ_k}本身再乘以e^{iδ2}
+        // 每项每点只需两次复数乘法；每GRID_RESEED_STEPS点按精确相位重新起算，限制舍入误差的累积与略去的三次以上的项
+        // 重起区间内略去的三次项约为a3·(GRID_RESEED_STEPS·h)³，日步长时远小于double的舍入误差
+        // 工作数组在栈上，不分配内存：项按GRID_TERM_BLOCK个一块（不小于最大的表，现有各表都只有一块，求和次序与不分块相同），
+        // 调用者按GRID_POINT_BLOCK个点一段调用，first为本段第一个点的序号，重起的位置与不分段时相同
+        static constexpr std::size_t GRID_RESEED_STEPS = 32;
+        static constexpr std::size_t GRID_TERM_BLOCK = 64;
+        static constexpr std::size_t GRID_POINT_BLOCK = GRID_RESEED_STEPS * 4;
+
+        // p(t + h) - p(t)，按差分的展开式计算，避免两个大数相减
+        static REAL poly_delta(const REAL *p, REAL t, REAL h) {
+            return h * (p[1] + p[2] * (2 * t + h) + p[3] * ((3 * t + 3 * h) * t + h * h) + p[4] * (((4 * t + 6 * h) * t + 4 * h * h) * t + h * h * h));
+        }
+
+        // 不超过GRID_TERM_BLOCK项
+        template <class Coefficient>
+        static void periodic_terms_grid_block(std::size_t n, Coefficient &&coef, bool sine, REAL t0, REAL h, std::size_t first, std::size_t count, double *out) {
+            double a[GRID_TERM_BLOCK], zc[GRID_TERM_BLOCK], zs[GRID_TERM_BLOCK], wc[GRID_TERM_BLOCK], ws[GRID_TERM_BLOCK], rc[GRID_TERM_BLOCK], rs[GRID_TERM_BLOCK];
+            for (std::size_t b = 0; b < count; b += GRID_RESEED_STEPS) {
+                const REAL t = t0 + h * (REAL)(first + b);
+                for (std::size_t i = 0; i < n; ++i) {
+                    REAL p[5]{}, s, c;
+                    a[i] = (double)coef(i, p);
+                    fast_sincos(p[0] + (p[1] + (p[2] + (p[3] + p[4] * t) * t) * t) * t, s, c);
+                    zc[i] = (double)c;
+                    zs[i] = (double)s;
+
+                    // 相位差很小，用double即可
+                    const REAL d1 = poly_delta(p, t, h), d2 = poly_delta(p, t + h, h) - d1;
+                    fast_sincos((double)d1, ws[i], wc[i]);
+                    if (d2 == 0) {
+                        rc[i] = 1;
+                        rs[i] = 0;
+                    }
+                    else {
+                        fast_sincos((double)d2, rs[i], rc[i]);
+                    }
+                }
+
+                const std::size_t m = std::min(count - b, GRID_RESEED_STEPS);
+                const double *z = sine ? zs : zc;
+                for (std::size_t k = 0; k < m; ++k) {
+                    double v = 0;
+                    for (std::size_t i = 0; i < n; ++i) v += a[i] * z[i];
+                    out[b + k] += v;
+
+                    for (std::size_t i = 0; i < n; ++i) {
+                        const double c = zc[i] * wc[i] - zs[i] * ws[i];
+                        const double s = zc[i] * ws[i] + zs[i] * wc[i];
+                        const double dc = wc[i] * rc[i] - ws[i] * rs[i];
+                        const double ds = wc[i] * rs[i] + ws[i] * rc[i];
+                        zc[i] = c;
+                        zs[i] = s;
+                        wc[i] = dc;
+                        ws[i] = ds;
+                    }
+                }
+            }
+        }
+
+        // 点first ~ first + count - 1，写入out[0 ~ count - 1]，first须为GRID_RESEED_STEPS的倍数
+        template <class Coefficient>
+        static void periodic_terms_grid(std::size_t n, Coefficient &&coef, bool sine, REAL t0, REAL h, std::size_t first, std::size_t count, double *out) {
+            for (std::size_t i0 = 0; i0 < n; i0 += GRID_TERM_BLOCK) {
+                periodic_terms_grid_block(std::min(n - i0, GRID_TERM_BLOCK), [&coef, i0](std::size_t i, REAL *p) { return coef(i0 + i, p); },
+                    sine, t0, h, first, count, out);
+            }
+        }
+
+        static void vsop87_periodic_terms_grid(const vsop87_coefficient_t *c, std::size_t n, REAL t0, REAL h, std::size_t first, std::size_t count, double *out) {
+            periodic_terms_grid(n, [c](std::size_t i, REAL *p) {
+                p[0] = c[i].b;
+                p[1] = c[i].c;
+                return c[i].a;
+            }, false, t0, h, first, count, out);
+        }
+
+        static void elp2000_periodic_terms_grid(const elp2000_coefficient_t *c, std::size_t n, REAL t0, REAL h, std::size_t first, std::size_t count, double *out) {
+            periodic_terms_grid(n, [c](std::size_t i, REAL *p) {
+                p[0] = c[i].a0;
+                p[1] = c[i].a1;
+                p[2] = c[i].a2;
+                p[3] = c[i].a3;
+                p[4] = c[i].a4;
+                return c[i].f;
+            }, true, t0, h, first, count, out);
+        }
+
+        // 带误差上界的值：真值落在[value - err, value + err]内
+        template <class T>
+        struct bounded_t {
+            T value, err;
+        };
+
+        template <class T>
+        struct real_traits;
+
+        template <>
+        struct real_traits<long double> {
+            static constexpr long double unit_roundoff = LDBL_EPSILON / 2;
+            static long double sin(long double x) { return std::sin(x); }
+            static long double cos(long double x) { return std::cos(x); }
+            static long double abs(long double x) { return std::fabs(x); }
+            static long double floor(long double x) { return std::floor(x); }
+        };
+
+#if ASTRONOMY_HAS_FLOAT128
+        template <>
+        struct real_traits<__float128> {
+            static constexpr __float128 unit_roundoff = (__float128)1 / ((__float128)(1ULL << 56) * (1ULL << 57));  // 2^-113，FLT128_EPSILON的一半
+            static __float128 sin(__float128 x) { return sinq(x); }
+            static __float128 cos(__float128 x) { return cosq(x); }
+            static __float128 abs(__float128 x) { return fabsq(x); }
+            static __float128 floor(__float128 x) { return floorq(x); }
+        };
+#endif
+
+        // 带舍入误差界的周期项求和
+        // 相位b+ct的舍入误差不超过2u(|b|+|ct|)，sin/cos按2u计，乘法与累加合计不超过(n+1)u·Σ|a|
+        template <class T>
+        static bounded_t<T> vsop87_periodic_terms_bounded(const vsop87_coefficient_t *c, std::size_t n, T t) {
+            typedef real_traits<T> R;
+            const T at = R::abs(t);
+            T v = 0, err = 0, mag = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto &e = c[i];
+                const T a = e.a, b = e.b, k = e.c;
+                v += a * R::cos(b + k * t);
+                err += R::abs(a) * ((R::abs(b) + R::abs(k) * at) * 2 + 2);
+                mag += R::abs(a);
+            }
+            err = (err + mag * (T)(n + 1)) * R::unit_roundoff;
+            return { v, err };
+        }
+
+        template <class T>
+        static bounded_t<T> elp2000_periodic_terms_bounded(const elp2000_coefficient_t *c, std::size_t n, T t) {
+            typedef real_traits<T> R;
+            const T at = R::abs(t);
+            T v = 0, err = 0, mag = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto &e = c[i];
+                const T a0 = e.a0, a1 = e.a1, a2 = e.a2, a3 = e.a3, a4 = e.a4, f = e.f;
+                v += f * R::sin(a0 + (a1 + (a2 + (a3 + a4 * t) * t) * t) * t);
+                // 四次多项式的霍纳求值，舍入误差不超过8u·Σ|a_k||t|^k
+                T phase = R::abs(a0) + (R::abs(a1) + (R::abs(a2) + (R::abs(a3) + R::abs(a4) * at) * at) * at) * at;
+                err += R::abs(f) * (phase * 8 + 2);
+                mag += R::abs(f);
+            }
+            err = (err + mag * (T)(n + 1)) * R::unit_roundoff;
+            return { v, err };
+        }
+
         template <class Dummy>
         struct impl {
             static const vsop87_coefficient_t E10[];
@@ -130,6 +346,8 @@ namespace astronomy {
 
             static void adjust_sun_aberration_and_nutation(REAL t, ecliptic_position_t &pos);
             static void adjust_sun_aberration_and_nutation_2(REAL t, ecliptic_position_t &pos);
+            static void calc_nutation(REAL t, REAL &longitude, REAL &obliquity);
+            static REAL calc_mean_obliquity(REAL t);
             static ecliptic_position_t calc_sun_position(REAL jd);
 
             static REAL calc_moon_longitude(REAL t);
@@ -142,8 +360,35 @@ namespace astronomy {
             static REAL get_sun_ecliptic_longitude(REAL jd);
 
             static REAL calc_delta_t(REAL t);
+            static std::size_t delta_t_segment(REAL t);
+
+            // 低精度档，err返回误差上界（与返回值同单位）
+            static double calc_earth_longitude_lite(double t, double &err);
+            static double calc_sun_longitude_lite(double jd, double &err);
+            static double calc_moon_longitude_lite(double t, double &err);
+            static double calc_moon_ecliptic_longitude_lite(double jd, double &err);
+            static double get_sun_ecliptic_longitude_lite(REAL jd, double &err);
+            static double get_moon_ecliptic_longitude_lite(REAL jd, double &err);
+
+            // 等间隔时刻jd0 + k·step（k = 0 ~ n - 1）的黄经，写入out，单位为度，归一化到[0, 360)
+            // 与全精度档使用相同的级数，周期项按旋转递推求和（见periodic_terms_grid），J2000前后数百年内与全精度档相差不到1e-11度
+            static void get_sun_ecliptic_longitude_grid(REAL jd0, REAL step, std::size_t n, double *out);
+            static void get_moon_ecliptic_longitude_grid(REAL jd0, REAL step, std::size_t n, double *out);
+
+            // 带误差界的全精度档，T可以是long double或__float128，jd为儒略日，返回角度
+            // 误差界只包含本级数在T精度下的计算误差，不包含级数本身与真实天体运动的偏差
+            template <class T> static bounded_t<T> get_sun_ecliptic_longitude_bounded(T jd);
+            template <class T> static bounded_t<T> get_moon_ecliptic_longitude_bounded(T jd);
         };
 
+        // 低精度档略去项的振幅阈值，单位为弧度
+        // 太阳约0.2角秒，月球约2角秒（月日黄经差变化快，同样的角度误差对应的时间误差小一个数量级）
+        static constexpr double LITE_SUN_CUTOFF = 1e-6;
+        static constexpr double LITE_MOON_CUTOFF = 1e-5;
+
+        // double舍入、忽略黄纬等带来的误差，远小于截断误差，这里给一个宽松的余量，单位为弧度
+        static constexpr double LITE_ROUNDING_MARGIN = 1e-8;
+
         // 地球运动VSOP87参数 黄经周期项
         template <class Dummy>
         const vsop87_coefficient_t impl<Dummy>::E10[] = {
@@ -281,6 +526,22 @@ namespace astronomy {
             return (L0 + (L1 + (L2 + (L3 + (L4 + L5 * t) * t) * t) * t) * t) / 1E11;
         }
 
+        template <class Dummy>
+        double impl<Dummy>::calc_earth_longitude_lite(double t, double &err) {
+            constexpr double cutoff = LITE_SUN_CUTOFF * 1E11;
+            double tail[6]{};
+            double L0 = vsop87_periodic_terms_lite(E10, sizeof(E10) / sizeof(*E10), t, cutoff, tail[0]);
+            double L1 = vsop87_periodic_terms_lite(E11, sizeof(E11) / sizeof(*E11), t, cutoff, tail[1]);
+            double L2 = vsop87_periodic_terms_lite(E12, sizeof(E12) / sizeof(*E12), t, cutoff, tail[2]);
+            double L3 = vsop87_periodic_terms_lite(E13, sizeof(E13) / sizeof(*E13), t, cutoff, tail[3]);
+            double L4 = vsop87_periodic_terms_lite(E14, sizeof(E14) / sizeof(*E14), t, cutoff, tail[4]);
+            double L5 = vsop87_periodic_terms_lite(E15, sizeof(E15) / sizeof(*E15), t, cutoff, tail[5]);
+
+            const double at = std::fabs(t);
+            err = (tail[0] + (tail[1] + (tail[2] + (tail[3] + (tail[4] + tail[5] * at) * at) * at) * at) * at) / 1E11;
+            return (L0 + (L1 + (L2 + (L3 + (L4 + L5 * t) * t) * t) * t) * t) / 1E11;
+        }
+
         // 黄纬周期项
         template <class Dummy>
         const vsop87_coefficient_t impl<Dummy>::E20[] = {
@@ -353,7 +614,7 @@ namespace astronomy {
             for (std::size_t i = 0, c = sizeof(NT) / sizeof(*NT); i < c; ++i) {
                 const auto &n = NT[i];
                 REAL v = n.a0 + (n.a1 + (n.a2 + (n.a3 + n.a4 * t1) * t1) * t1) * t1;
-                longitude += (n.sin1 + n.sin2 * t1 / 10) * std::sin(v);
+                longitude += (n.sin1 + n.sin2 * t1 / 10) * fast_sin(v);
                 //obliquity += (n.cos1 + n.cos2 * t1 / 10) * std::cos(v);
             }
 
@@ -362,6 +623,31 @@ namespace astronomy {
             pos.longitude = clamp_randians(pos.longitude + longitude);
         }
 
+        // 黄经章动与交角章动，单位为弧度
+        template <class Dummy>
+        void impl<Dummy>::calc_nutation(REAL t, REAL &longitude, REAL &obliquity) {
+            REAL t1 = t / 36525.0;
+            longitude = 0;
+            obliquity = 0;
+            for (std::size_t i = 0, c = sizeof(NT) / sizeof(*NT); i < c; ++i) {
+                const auto &n = NT[i];
+                REAL v = n.a0 + (n.a1 + (n.a2 + (n.a3 + n.a4 * t1) * t1) * t1) * t1;
+                REAL sv, cv;
+                fast_sincos(v, sv, cv);
+                longitude += (n.sin1 + n.sin2 * t1 / 10) * sv;
+                obliquity += (n.cos1 + n.cos2 * t1 / 10) * cv;
+            }
+            longitude /= (36000000.0 * DEGREE_PER_RADIAN);
+            obliquity /= (36000000.0 * DEGREE_PER_RADIAN);
+        }
+
+        // 平黄赤交角（IAU 1980），单位为弧度
+        template <class Dummy>
+        REAL impl<Dummy>::calc_mean_obliquity(REAL t) {
+            const REAL t1 = t / 36525.0;
+            return (84381.448 + (-46.8150 + (-0.00059 + 0.001813 * t1) * t1) * t1) * (RADIAN_PER_DEGREE / 3600);
+        }
+
         // 太阳视位置
         template <class Dummy>
         ecliptic_position_t impl<Dummy>::calc_sun_position(REAL jd) {
@@ -374,6 +660,35 @@ namespace astronomy {
             return pos;
         }
 
+        // 太阳视黄经低精度档，章动项全部保留，黄纬取0
+        template <class Dummy>
+        double impl<Dummy>::calc_sun_longitude_lite(double jd, double &err) {
+            static const double E[] = { 0.016708634, -0.000042037, -0.0000001267 };
+            static const double P[] = { 102.93735 * RADIAN_PER_DEGREE, 1.71946 * RADIAN_PER_DEGREE, 0.00046 * RADIAN_PER_DEGREE };
+            static const double L[] = { 280.4664567 * RADIAN_PER_DEGREE, 36000.76982779 * RADIAN_PER_DEGREE, 0.0003032028 * RADIAN_PER_DEGREE, RADIAN_PER_DEGREE / 49931000.0, RADIAN_PER_DEGREE / -153000000.0 };
+            static const double K = 20.49552 * RADIAN_PER_DEGREE / 3600.0;
+
+            double lon = calc_earth_longitude_lite(jd / 365250.0, err) + M_PI;
+
+            double t1 = jd / 36525.0;
+            double l = L[0] + (L[1] + (L[2] + (L[3] + L[4] * t1) * t1) * t1) * t1;
+            double p = P[0] + (P[1] + P[2] * t1) * t1;
+            double e = E[0] + (E[1] + E[2] * t1) * t1;
+            lon -= K * (std::cos(l - lon) - e * std::cos(p - lon));
+
+            double nutation = 0;
+            for (std::size_t i = 0, c = sizeof(NT) / sizeof(*NT); i < c; ++i) {
+                const auto &n = NT[i];
+                double v = (double)n.a0 + ((double)n.a1 + ((double)n.a2 + ((double)n.a3 + (double)n.a4 * t1) * t1) * t1) * t1;
+                nutation += ((double)n.sin1 + (double)n.sin2 * t1 / 10) * fast_sin(v);
+            }
+            lon += nutation / (36000000.0 * DEGREE_PER_RADIAN);
+
+            // 光行差用的是带误差的黄经，其误差最多被放大K倍
+            err = err * (1 + 2 * K) + LITE_ROUNDING_MARGIN;
+            return lon;
+        }
+
         template <class Dummy>
         const elp2000_coefficient_t impl<Dummy>::M10[] = {
             { 22639.5858800,   2.3555545723,   8328.6914247251,  1.5231275E-04,  2.5041111E-07, -1.1863391E-09 },
@@ -471,81 +786,101 @@ namespace astronomy {
             return clamp_randians(L);
         }
 
+        template <class Dummy>
+        double impl<Dummy>::calc_moon_longitude_lite(double t, double &err) {
+            static const double E[] = { 3.81034392032, 8.39968473021E+03, -3.31919929753E-05, 3.20170955005E-08, -1.53637455544E-10 };
+
+            // 周期项单位为角秒
+            constexpr double cutoff = LITE_MOON_CUTOFF * DEGREE_PER_RADIAN * 3600;
+            double tail[3]{};
+            double L0 = elp2000_periodic_terms_lite(M10, sizeof(M10) / sizeof(*M10), t, cutoff, tail[0]);
+            double L1 = elp2000_periodic_terms_lite(M11, sizeof(M11) / sizeof(*M11), t, cutoff, tail[1]);
+            double L2 = elp2000_periodic_terms_lite(M12, sizeof(M12) / sizeof(*M12), t, cutoff, tail[2]);
+
+            const double at = std::fabs(t);
+            err = (tail[0] + (tail[1] + tail[2] * at) * at) * (RADIAN_PER_DEGREE / 3600) + LITE_ROUNDING_MARGIN;
+
+            double L = L0 + (L1 + L2 * t) * t;
+            L *= (RADIAN_PER_DEGREE / 3600);
+            L += E[0] + (E[1] + (E[2] + (E[3] + E[4] * t) * t) * t) * t;
+            return L;
+        }
+
         template <class Dummy>
         const elp2000_coefficient_t impl<Dummy>::M20[] = {
-            18461.2400600,  1.6279052448,   8433.4661576405, -6.4021295E-05, -4.9499477E-09,  2.0216731E-11,
-             1010.1671484,  3.9834598170,  16762.1575823656,  8.8291456E-05,  2.4546117E-07, -1.1661223E-09,
-              999.6936555,  0.7276493275,   -104.7747329154,  2.1633405E-04,  2.5536106E-07, -1.2065558E-09,
-              623.6524746,  8.7690283983,   7109.2881325435, -2.1668263E-06,  6.8896872E-08, -3.2894608E-10,
-              199.4837596,  9.6692843156,  15647.5290230993, -2.8252217E-04, -1.9141414E-07,  8.9782646E-10,
-              166.5741153,  6.4134738261,  -1219.4032921817, -1.5447958E-04, -1.8151424E-07,  8.5739300E-10,
-              117.2606951, 12.0248388879,  23976.2204478244, -1.3020942E-04,  5.8996977E-08, -2.8851262E-10,
-               61.9119504,  6.3390143893,  25090.8490070907,  2.4060421E-04,  4.9587228E-07, -2.3524614E-09,
-               33.3572027, 11.1245829706,  15437.9795572686,  1.5014592E-04,  3.1930799E-07, -1.5152852E-09,
-               31.7596709,  3.0832038997,   8223.9166918098,  3.6864680E-04,  5.0577218E-07, -2.3928949E-09,
-               29.5766003,  8.8121540801,   6480.9861772950,  4.9705523E-07,  6.8280480E-08, -2.7450635E-10,
-               15.5662654,  4.0579192538,  -9548.0947169068, -3.0679233E-04, -4.3192536E-07,  2.0437321E-09,
-               15.1215543, 14.3803934601,  32304.9118725496,  2.2103334E-05,  3.0940809E-07, -1.4748517E-09,
-              -12.0941511,  8.7259027166,   7737.5900877920, -4.8307078E-06,  6.9513264E-08, -3.8338581E-10,
-                8.8681426,  9.7124099974,  15019.2270678508, -2.7985829E-04, -1.9203053E-07,  9.5226618E-10,
-                8.0450400,  0.6687636586,   8399.7091105030, -3.3191993E-05,  3.2017096E-08, -1.5363746E-10,
-                7.9585542, 12.0679645696,  23347.9184925760, -1.2754553E-04,  5.8380585E-08, -2.3407289E-10,
-                7.4345550,  6.4565995078,  -1847.7052474301, -1.5181570E-04, -1.8213063E-07,  9.1183272E-10,
-               -6.7314363, -4.0265854988, -16133.8556271171, -9.0955337E-05, -2.4484477E-07,  1.1116826E-09,
-                6.5795750, 16.8104074692,  14323.3509980023, -2.2066770E-04, -1.1756732E-07,  5.4866364E-10,
-               -6.4600721,  1.5847795630,   9061.7681128890, -6.6685176E-05, -4.3335556E-09, -3.4222998E-11,
-               -6.2964773,  4.8837157343,  25300.3984729215, -1.9206388E-04, -1.4849843E-08,  6.0650192E-11,
-               -5.6323538, -0.7707750092,    733.0766881638, -2.1899793E-04, -2.5474467E-07,  1.1521161E-09,
-               -5.3683961,  6.8263720663,  16204.8433027325, -9.7115356E-05,  2.7023515E-08, -1.3414795E-10,
-               -5.3112784,  3.9403341353,  17390.4595376141,  8.5627574E-05,  2.4607756E-07, -1.2205621E-09,
-               -5.0759179,  0.6845236457,    523.5272223331,  2.1367016E-04,  2.5597745E-07, -1.2609955E-09,
-               -4.8396143, -1.6710309265,  -7805.1642023920,  6.1357413E-05,  5.5663398E-09, -7.4656459E-11,
-               -4.8057401,  3.5705615768,   -662.0890125485,  3.0927234E-05,  3.6923410E-08, -1.7458141E-10,
-                3.9840545,  8.6945689615,  33419.5404318159,  3.9291696E-04,  7.4628340E-07, -3.5388005E-09,
-                3.6744619, 19.1659620415,  22652.0424227274, -6.8354947E-05,  1.3284380E-07, -6.3767543E-10,
-                2.9984815, 20.0662179587,  31190.2833132833, -3.4871029E-04, -1.2746721E-07,  5.8909710E-10,
-                2.7986413, -2.5281611620, -16971.7070481963,  3.4437664E-04,  2.6526096E-07, -1.2469893E-09,
-                2.4138774, 17.7106633865,  22861.5918885581, -5.0102304E-04, -3.7787833E-07,  1.7754362E-09,
-                2.1863132,  5.5132179088,  -9757.6441827375,  1.2587576E-04,  7.8796768E-08, -3.6937954E-10,
-                2.1461692, 13.4801375428,  23766.6709819937,  3.0245868E-04,  5.6971910E-07, -2.7016242E-09,
-                1.7659832, 11.1677086523,  14809.6776020201,  1.5280981E-04,  3.1869159E-07, -1.4608454E-09,
-               -1.6244212,  7.3137297434,   7318.8375983742, -4.3483492E-04, -4.4182525E-07,  2.0841655E-09,
-                1.5813036,  5.4387584720,  16552.6081165349,  5.2095955E-04,  7.5618329E-07, -3.5792340E-09,
-                1.5197528, 16.7359480324,  40633.6032972747,  1.7441609E-04,  5.5981921E-07, -2.6611908E-09,
-                1.5156341,  1.7023646816, -17876.7861416319, -4.5910508E-04, -6.8233647E-07,  3.2300712E-09,
-                1.5102092,  5.4977296450,   8399.6847301375, -3.3094061E-05,  3.1973462E-08, -1.5436468E-10,
-               -1.3178223,  9.6261586339,  16275.8309783478, -2.8518605E-04, -1.9079775E-07,  8.4338673E-10,
-               -1.2642739, 11.9817132061,  24604.5224030729, -1.3287330E-04,  5.9613369E-08, -3.4295235E-10,
-                1.1918723, 22.4217725310,  39518.9747380084, -1.9639754E-04,  1.2294390E-07, -5.9724197E-10,
-                1.1346110, 14.4235191419,  31676.6099173011,  2.4767216E-05,  3.0879170E-07, -1.4204120E-09,
-                1.0857810,  8.8552797618,   5852.6842220465,  3.1609367E-06,  6.7664088E-08, -2.2006663E-10,
-               -1.0193852,  7.2392703065,  33629.0898976466, -3.9751134E-05,  2.3556127E-07, -1.1256889E-09,
-               -0.8227141, 11.0814572888,  16066.2815125171,  1.4748204E-04,  3.1992438E-07, -1.5697249E-09,
-                0.8042238,  3.5274358950,    -33.7870573000,  2.8263353E-05,  3.7539802E-08, -2.2902113E-10,
-                0.8025939,  6.7832463846,  16833.1452579809, -9.9779237E-05,  2.7639907E-08, -1.8858767E-10,
-               -0.7931866, -6.3821400710, -24462.5470518423, -2.4326809E-04, -4.9525589E-07,  2.2980217E-09,
-               -0.7910153,  6.3703481443,   -591.1013369332, -1.5714346E-04, -1.8089785E-07,  8.0295327E-10,
-               -0.6674056,  9.1819266386,  24533.5347274576,  5.5197395E-05,  2.7743463E-07, -1.3204870E-09,
-                0.6502226,  4.1010449356, -10176.3966721553, -3.0412845E-04, -4.3254175E-07,  2.0981718E-09,
-               -0.6388131,  6.2958887075,  25719.1509623392,  2.3794032E-04,  4.9648867E-07, -2.4069012E-09
+            { 18461.2400600,  1.6279052448,   8433.4661576405, -6.4021295E-05, -4.9499477E-09,  2.0216731E-11 },
+             { 1010.1671484,  3.9834598170,  16762.1575823656,  8.8291456E-05,  2.4546117E-07, -1.1661223E-09 },
+              { 999.6936555,  0.7276493275,   -104.7747329154,  2.1633405E-04,  2.5536106E-07, -1.2065558E-09 },
+              { 623.6524746,  8.7690283983,   7109.2881325435, -2.1668263E-06,  6.8896872E-08, -3.2894608E-10 },
+              { 199.4837596,  9.6692843156,  15647.5290230993, -2.8252217E-04, -1.9141414E-07,  8.9782646E-10 },
+              { 166.5741153,  6.4134738261,  -1219.4032921817, -1.5447958E-04, -1.8151424E-07,  8.5739300E-10 },
+              { 117.2606951, 12.0248388879,  23976.2204478244, -1.3020942E-04,  5.8996977E-08, -2.8851262E-10 },
+               { 61.9119504,  6.3390143893,  25090.8490070907,  2.4060421E-04,  4.9587228E-07, -2.3524614E-09 },
+               { 33.3572027, 11.1245829706,  15437.9795572686,  1.5014592E-04,  3.1930799E-07, -1.5152852E-09 },
+               { 31.7596709,  3.0832038997,   8223.9166918098,  3.6864680E-04,  5.0577218E-07, -2.3928949E-09 },
+               { 29.5766003,  8.8121540801,   6480.9861772950,  4.9705523E-07,  6.8280480E-08, -2.7450635E-10 },
+               { 15.5662654,  4.0579192538,  -9548.0947169068, -3.0679233E-04, -4.3192536E-07,  2.0437321E-09 },
+               { 15.1215543, 14.3803934601,  32304.9118725496,  2.2103334E-05,  3.0940809E-07, -1.4748517E-09 },
+              { -12.0941511,  8.7259027166,   7737.5900877920, -4.8307078E-06,  6.9513264E-08, -3.8338581E-10 },
+                { 8.8681426,  9.7124099974,  15019.2270678508, -2.7985829E-04, -1.9203053E-07,  9.5226618E-10 },
+                { 8.0450400,  0.6687636586,   8399.7091105030, -3.3191993E-05,  3.2017096E-08, -1.5363746E-10 },
+                { 7.9585542, 12.0679645696,  23347.9184925760, -1.2754553E-04,  5.8380585E-08, -2.3407289E-10 },
+                { 7.4345550,  6.4565995078,  -1847.7052474301, -1.5181570E-04, -1.8213063E-07,  9.1183272E-10 },
+               { -6.7314363, -4.0265854988, -16133.8556271171, -9.0955337E-05, -2.4484477E-07,  1.1116826E-09 },
+                { 6.5795750, 16.8104074692,  14323.3509980023, -2.2066770E-04, -1.1756732E-07,  5.4866364E-10 },
+               { -6.4600721,  1.5847795630,   9061.7681128890, -6.6685176E-05, -4.3335556E-09, -3.4222998E-11 },
+               { -6.2964773,  4.8837157343,  25300.3984729215, -1.9206388E-04, -1.4849843E-08,  6.0650192E-11 },
+               { -5.6323538, -0.7707750092,    733.0766881638, -2.1899793E-04, -2.5474467E-07,  1.1521161E-09 },
+               { -5.3683961,  6.8263720663,  16204.8433027325, -9.7115356E-05,  2.7023515E-08, -1.3414795E-10 },
+               { -5.3112784,  3.9403341353,  17390.4595376141,  8.5627574E-05,  2.4607756E-07, -1.2205621E-09 },
+               { -5.0759179,  0.6845236457,    523.5272223331,  2.1367016E-04,  2.5597745E-07, -1.2609955E-09 },
+               { -4.8396143, -1.6710309265,  -7805.1642023920,  6.1357413E-05,  5.5663398E-09, -7.4656459E-11 },
+               { -4.8057401,  3.5705615768,   -662.0890125485,  3.0927234E-05,  3.6923410E-08, -1.7458141E-10 },
+                { 3.9840545,  8.6945689615,  33419.5404318159,  3.9291696E-04,  7.4628340E-07, -3.5388005E-09 },
+                { 3.6744619, 19.1659620415,  22652.0424227274, -6.8354947E-05,  1.3284380E-07, -6.3767543E-10 },
+                { 2.9984815, 20.0662179587,  31190.2833132833, -3.4871029E-04, -1.2746721E-07,  5.8909710E-10 },
+                { 2.7986413, -2.5281611620, -16971.7070481963,  3.4437664E-04,  2.6526096E-07, -1.2469893E-09 },
+                { 2.4138774, 17.7106633865,  22861.5918885581, -5.0102304E-04, -3.7787833E-07,  1.7754362E-09 },
+                { 2.1863132,  5.5132179088,  -9757.6441827375,  1.2587576E-04,  7.8796768E-08, -3.6937954E-10 },
+                { 2.1461692, 13.4801375428,  23766.6709819937,  3.0245868E-04,  5.6971910E-07, -2.7016242E-09 },
+                { 1.7659832, 11.1677086523,  14809.6776020201,  1.5280981E-04,  3.1869159E-07, -1.4608454E-09 },
+               { -1.6244212,  7.3137297434,   7318.8375983742, -4.3483492E-04, -4.4182525E-07,  2.0841655E-09 },
+                { 1.5813036,  5.4387584720,  16552.6081165349,  5.2095955E-04,  7.5618329E-07, -3.5792340E-09 },
+                { 1.5197528, 16.7359480324,  40633.6032972747,  1.7441609E-04,  5.5981921E-07, -2.6611908E-09 },
+                { 1.5156341,  1.7023646816, -17876.7861416319, -4.5910508E-04, -6.8233647E-07,  3.2300712E-09 },
+                { 1.5102092,  5.4977296450,   8399.6847301375, -3.3094061E-05,  3.1973462E-08, -1.5436468E-10 },
+               { -1.3178223,  9.6261586339,  16275.8309783478, -2.8518605E-04, -1.9079775E-07,  8.4338673E-10 },
+               { -1.2642739, 11.9817132061,  24604.5224030729, -1.3287330E-04,  5.9613369E-08, -3.4295235E-10 },
+                { 1.1918723, 22.4217725310,  39518.9747380084, -1.9639754E-04,  1.2294390E-07, -5.9724197E-10 },
+                { 1.1346110, 14.4235191419,  31676.6099173011,  2.4767216E-05,  3.0879170E-07, -1.4204120E-09 },
+                { 1.0857810,  8.8552797618,   5852.6842220465,  3.1609367E-06,  6.7664088E-08, -2.2006663E-10 },
+               { -1.0193852,  7.2392703065,  33629.0898976466, -3.9751134E-05,  2.3556127E-07, -1.1256889E-09 },
+               { -0.8227141, 11.0814572888,  16066.2815125171,  1.4748204E-04,  3.1992438E-07, -1.5697249E-09 },
+                { 0.8042238,  3.5274358950,    -33.7870573000,  2.8263353E-05,  3.7539802E-08, -2.2902113E-10 },
+                { 0.8025939,  6.7832463846,  16833.1452579809, -9.9779237E-05,  2.7639907E-08, -1.8858767E-10 },
+               { -0.7931866, -6.3821400710, -24462.5470518423, -2.4326809E-04, -4.9525589E-07,  2.2980217E-09 },
+               { -0.7910153,  6.3703481443,   -591.1013369332, -1.5714346E-04, -1.8089785E-07,  8.0295327E-10 },
+               { -0.6674056,  9.1819266386,  24533.5347274576,  5.5197395E-05,  2.7743463E-07, -1.3204870E-09 },
+                { 0.6502226,  4.1010449356, -10176.3966721553, -3.0412845E-04, -4.3254175E-07,  2.0981718E-09 },
+               { -0.6388131,  6.2958887075,  25719.1509623392,  2.3794032E-04,  4.9648867E-07, -2.4069012E-09 },
         };
 
         template <class Dummy>
         const elp2000_coefficient_t impl<Dummy>::M21[] = {
-            0.0743000, 11.9537467337,  6480.9861772950,  4.9705523E-07,  6.8280480E-08, -2.7450635E-10,
-            0.0304300,  8.7259027166,  7737.5900877920, -4.8307078E-06,  6.9513264E-08, -3.8338581E-10,
-            0.0222900, 12.8540026510, 15019.2270678508, -2.7985829E-04, -1.9203053E-07,  9.5226618E-10,
-            0.0199900, 15.2095572232, 23347.9184925760, -1.2754553E-04,  5.8380585E-08, -2.3407289E-10,
-            0.0186900,  9.5981921614, -1847.7052474301, -1.5181570E-04, -1.8213063E-07,  9.1183272E-10,
-            0.0169600,  7.1681781524, 16133.8556271171,  9.0955337E-05,  2.4484477E-07, -1.1116826E-09,
-            0.0162300,  1.5847795630,  9061.7681128890, -6.6685176E-05, -4.3335556E-09, -3.4222998E-11,
-            0.0141900, -0.7707750092,   733.0766881638, -2.1899793E-04, -2.5474467E-07,  1.1521161E-09
+            { 0.0743000, 11.9537467337,  6480.9861772950,  4.9705523E-07,  6.8280480E-08, -2.7450635E-10 },
+            { 0.0304300,  8.7259027166,  7737.5900877920, -4.8307078E-06,  6.9513264E-08, -3.8338581E-10 },
+            { 0.0222900, 12.8540026510, 15019.2270678508, -2.7985829E-04, -1.9203053E-07,  9.5226618E-10 },
+            { 0.0199900, 15.2095572232, 23347.9184925760, -1.2754553E-04,  5.8380585E-08, -2.3407289E-10 },
+            { 0.0186900,  9.5981921614, -1847.7052474301, -1.5181570E-04, -1.8213063E-07,  9.1183272E-10 },
+            { 0.0169600,  7.1681781524, 16133.8556271171,  9.0955337E-05,  2.4484477E-07, -1.1116826E-09 },
+            { 0.0162300,  1.5847795630,  9061.7681128890, -6.6685176E-05, -4.3335556E-09, -3.4222998E-11 },
+            { 0.0141900, -0.7707750092,   733.0766881638, -2.1899793E-04, -2.5474467E-07,  1.1521161E-09 },
         };
 
         template <class Dummy>
         REAL impl<Dummy>::calc_moon_latitude(REAL t) {
-            REAL L0 = periodic_terms(M20, sizeof(M20) / sizeof(*M20), t);
-            REAL L1 = periodic_terms(M21, sizeof(M21) / sizeof(*M21), t);
+            REAL L0 = elp2000_periodic_terms(M20, sizeof(M20) / sizeof(*M20), t);
+            REAL L1 = elp2000_periodic_terms(M21, sizeof(M21) / sizeof(*M21), t);
 
             REAL L = L0 + L1 * t;
             L *= (RADIAN_PER_DEGREE / 3600);
@@ -588,6 +923,226 @@ namespace astronomy {
             return calc_sun_position(jd - JD2000).longitude * DEGREE_PER_RADIAN;
         }
 
+        template <class Dummy>
+        double impl<Dummy>::calc_moon_ecliptic_longitude_lite(double jd, double &err) {
+            static const double P[] = { 50287.92262, 111.24406, 0.07699, -0.23479, -0.00178, 0.00018, 0.00001 };
+
+            double l = calc_moon_longitude_lite(jd / 36525.0, err);
+
+            double t = jd / 365250.0;
+            double t0 = 1, v = 0;
+            for (auto i : P) {
+                t0 *= t;
+                v += i * t0;
+            }
+
+            return l + (v + 2.9965 * t) * (RADIAN_PER_DEGREE / 3600);
+        }
+
+        // 以下两个低精度档返回角度，不做0~360的归一化
+        template <class Dummy>
+        double impl<Dummy>::get_moon_ecliptic_longitude_lite(REAL jd, double &err) {
+            double l = calc_moon_ecliptic_longitude_lite((double)(jd - JD2000), err);
+            err *= DEGREE_PER_RADIAN;
+            return l * DEGREE_PER_RADIAN;
+        }
+
+        template <class Dummy>
+        double impl<Dummy>::get_sun_ecliptic_longitude_lite(REAL jd, double &err) {
+            double l = calc_sun_longitude_lite((double)(jd - JD2000), err);
+            err *= DEGREE_PER_RADIAN;
+            return l * DEGREE_PER_RADIAN;
+        }
+
+        // 与calc_sun_position相同的计算
+        template <class Dummy>
+        void impl<Dummy>::get_sun_ecliptic_longitude_grid(REAL jd0, REAL step, std::size_t n, double *out) {
+            static const REAL E[] = { 0.016708634, -0.000042037, -0.0000001267 };
+            static const REAL P[] = { 102.93735 * RADIAN_PER_DEGREE, 1.71946 * RADIAN_PER_DEGREE, 0.00046 * RADIAN_PER_DEGREE };
+            static const REAL L[] = { 280.4664567 * RADIAN_PER_DEGREE, 36000.76982779 * RADIAN_PER_DEGREE, 0.0003032028 * RADIAN_PER_DEGREE, RADIAN_PER_DEGREE / 49931000.0, RADIAN_PER_DEGREE / -153000000.0 };
+            static const REAL K = 20.49552 * RADIAN_PER_DEGREE / 3600.0;
+
+            const REAL d0 = jd0 - JD2000;
+            const vsop87_coefficient_t *tables[] = { E10, E11, E12, E13, E14, E15, E20, E21 };
+            const std::size_t sizes[] = { sizeof(E10) / sizeof(*E10), sizeof(E11) / sizeof(*E11), sizeof(E12) / sizeof(*E12),
+                sizeof(E13) / sizeof(*E13), sizeof(E14) / sizeof(*E14), sizeof(E15) / sizeof(*E15), sizeof(E20) / sizeof(*E20), sizeof(E21) / sizeof(*E21) };
+            double S[GRID_POINT_BLOCK * 10];  // 黄经L0 ~ L5，黄纬B0、B1，章动的sin1、sin2两部分
+            for (std::size_t first = 0; first < n; first += GRID_POINT_BLOCK) {
+                const std::size_t m = std::min(n - first, GRID_POINT_BLOCK);
+                std::fill(S, S + m * 10, 0.0);
+                for (int j = 0; j < 8; ++j) {
+                    vsop87_periodic_terms_grid(tables[j], sizes[j], d0 / 365250, step / 365250, first, m, &S[j * m]);
+                }
+                for (int j = 0; j < 2; ++j) {
+                    periodic_terms_grid(sizeof(NT) / sizeof(*NT), [j](std::size_t i, REAL *p) {
+                        const auto &e = NT[i];
+                        p[0] = e.a0;
+                        p[1] = e.a1;
+                        p[2] = e.a2;
+                        p[3] = e.a3;
+                        p[4] = e.a4;
+                        return j == 0 ? e.sin1 : e.sin2;
+                    }, true, d0 / 36525, step / 36525, first, m, &S[(8 + j) * m]);
+                }
+
+                for (std::size_t k = 0; k < m; ++k) {
+                    const REAL d = d0 + step * (REAL)(first + k);
+                    const REAL t = d / 365250, t1 = d / 36525;
+                    const double *s = &S[k];
+                    REAL lon = (s[0] + (s[m] + (s[2 * m] + (s[3 * m] + (s[4 * m] + s[5 * m] * t) * t) * t) * t) * t) / 1E11 + M_PI;
+                    const REAL lat = -(s[6 * m] + s[7 * m] * t) / 1E11;
+
+                    const REAL l = L[0] + (L[1] + (L[2] + (L[3] + L[4] * t1) * t1) * t1) * t1;
+                    const REAL p = P[0] + (P[1] + P[2] * t1) * t1;
+                    const REAL e = E[0] + (E[1] + E[2] * t1) * t1;
+                    lon -= K * (fast_cos(l - lon) - e * fast_cos(p - lon)) / std::cos(lat);
+                    lon += (s[8 * m] + s[9 * m] * t1 / 10) / (36000000.0 * DEGREE_PER_RADIAN);
+                    out[first + k] = (double)(clamp_randians(lon) * DEGREE_PER_RADIAN);
+                }
+            }
+        }
+
+        // 与calc_moon_ecliptic_longitude相同的计算
+        template <class Dummy>
+        void impl<Dummy>::get_moon_ecliptic_longitude_grid(REAL jd0, REAL step, std::size_t n, double *out) {
+            static const REAL E[] = { 3.81034392032, 8.39968473021E+03, -3.31919929753E-05, 3.20170955005E-08, -1.53637455544E-10 };
+            static const REAL P[] = { 50287.92262, 111.24406, 0.07699, -0.23479, -0.00178, 0.00018, 0.00001 };
+
+            const REAL d0 = jd0 - JD2000;
+            double S[GRID_POINT_BLOCK * 3];  // L0 ~ L2
+            for (std::size_t first = 0; first < n; first += GRID_POINT_BLOCK) {
+                const std::size_t m = std::min(n - first, GRID_POINT_BLOCK);
+                std::fill(S, S + m * 3, 0.0);
+                elp2000_periodic_terms_grid(M10, sizeof(M10) / sizeof(*M10), d0 / 36525, step / 36525, first, m, &S[0]);
+                elp2000_periodic_terms_grid(M11, sizeof(M11) / sizeof(*M11), d0 / 36525, step / 36525, first, m, &S[m]);
+                elp2000_periodic_terms_grid(M12, sizeof(M12) / sizeof(*M12), d0 / 36525, step / 36525, first, m, &S[2 * m]);
+
+                for (std::size_t k = 0; k < m; ++k) {
+                    const REAL d = d0 + step * (REAL)(first + k);
+                    const REAL t = d / 36525;
+                    REAL L = (S[k] + (S[m + k] + S[2 * m + k] * t) * t) * (RADIAN_PER_DEGREE / 3600);
+                    L += E[0] + (E[1] + (E[2] + (E[3] + E[4] * t) * t) * t) * t;
+
+                    const REAL tm = d / 365250;
+                    REAL t0 = 1, v = 0;
+                    for (auto i : P) {
+                        t0 *= tm;
+                        v += i * t0;
+                    }
+                    out[first + k] = (double)(clamp_randians(std::fmod(L + (v + 2.9965 * tm) * (RADIAN_PER_DEGREE / 3600), PI_2)) * DEGREE_PER_RADIAN);
+                }
+            }
+        }
+
+        // 与calc_sun_position相同的计算，黄经不做0~360的归一化
+        template <class Dummy>
+        template <class T>
+        bounded_t<T> impl<Dummy>::get_sun_ecliptic_longitude_bounded(T jd) {
+            typedef real_traits<T> R;
+            static const REAL E[] = { 0.016708634, -0.000042037, -0.0000001267 };
+            static const REAL P[] = { 102.93735 * RADIAN_PER_DEGREE, 1.71946 * RADIAN_PER_DEGREE, 0.00046 * RADIAN_PER_DEGREE };
+            static const REAL L[] = { 280.4664567 * RADIAN_PER_DEGREE, 36000.76982779 * RADIAN_PER_DEGREE, 0.0003032028 * RADIAN_PER_DEGREE, RADIAN_PER_DEGREE / 49931000.0, RADIAN_PER_DEGREE / -153000000.0 };
+            static const REAL K = 20.49552 * RADIAN_PER_DEGREE / 3600.0;
+            const T u = R::unit_roundoff;
+
+            const T d = jd - (T)JD2000;
+            const T t = d / 365250, at = R::abs(t);
+
+            // 日心黄经
+            const bounded_t<T> Ls[] = {
+                vsop87_periodic_terms_bounded<T>(E10, sizeof(E10) / sizeof(*E10), t),
+                vsop87_periodic_terms_bounded<T>(E11, sizeof(E11) / sizeof(*E11), t),
+                vsop87_periodic_terms_bounded<T>(E12, sizeof(E12) / sizeof(*E12), t),
+                vsop87_periodic_terms_bounded<T>(E13, sizeof(E13) / sizeof(*E13), t),
+                vsop87_periodic_terms_bounded<T>(E14, sizeof(E14) / sizeof(*E14), t),
+                vsop87_periodic_terms_bounded<T>(E15, sizeof(E15) / sizeof(*E15), t),
+            };
+            T lon = Ls[5].value, err = Ls[5].err, mag = R::abs(Ls[5].value);
+            for (int i = 4; i >= 0; --i) {
+                lon = Ls[i].value + lon * t;
+                err = Ls[i].err + err * at;
+                mag = R::abs(Ls[i].value) + mag * at;
+            }
+            lon /= 1E11;
+            err = (err + mag * 12 * u) / 1E11;
+
+            // 地心黄纬，只用于光行差修正的cos(latitude)，其误差影响可忽略
+            const T b0 = vsop87_periodic_terms_bounded<T>(E20, sizeof(E20) / sizeof(*E20), t).value;
+            const T b1 = vsop87_periodic_terms_bounded<T>(E21, sizeof(E21) / sizeof(*E21), t).value;
+            const T lat = -(b0 + b1 * t) / 1E11;
+
+            lon += (T)M_PI;
+            err += (R::abs(lon) + 4) * u;
+
+            // 光行差，对黄经误差的放大不超过K(1+e)
+            const T t1 = d / 36525, at1 = R::abs(t1);
+            const T l = (T)L[0] + ((T)L[1] + ((T)L[2] + ((T)L[3] + (T)L[4] * t1) * t1) * t1) * t1;
+            const T p = (T)P[0] + ((T)P[1] + (T)P[2] * t1) * t1;
+            const T e = (T)E[0] + ((T)E[1] + (T)E[2] * t1) * t1;
+            lon -= (T)K * (R::cos(l - lon) - e * R::cos(p - lon)) / R::cos(lat);
+            err += (T)K * 2 * (err + (R::abs(l) + R::abs(p) + R::abs(lon) + 8) * 4 * u) + R::abs(lon) * u;
+
+            // 天体章动
+            T nutation = 0, nerr = 0;
+            for (std::size_t i = 0, c = sizeof(NT) / sizeof(*NT); i < c; ++i) {
+                const auto &n = NT[i];
+                const T a0 = n.a0, a1 = n.a1, a2 = n.a2, a3 = n.a3, a4 = n.a4;
+                const T v = a0 + (a1 + (a2 + (a3 + a4 * t1) * t1) * t1) * t1;
+                const T phase = R::abs(a0) + (R::abs(a1) + (R::abs(a2) + (R::abs(a3) + R::abs(a4) * at1) * at1) * at1) * at1;
+                const T coef = (T)n.sin1 + (T)n.sin2 * t1 / 10;
+                nutation += coef * R::sin(v);
+                nerr += R::abs(coef) * (phase * 8 + 8);
+            }
+            nerr = (nerr + R::abs(nutation) * 16) * u;
+            lon += nutation / (T)(36000000.0 * DEGREE_PER_RADIAN);
+            err += nerr / (T)(36000000.0 * DEGREE_PER_RADIAN) + R::abs(lon) * 2 * u;
+
+            return { lon * (T)DEGREE_PER_RADIAN, (err + R::abs(lon) * u) * (T)DEGREE_PER_RADIAN };
+        }
+
+        // 与calc_moon_ecliptic_longitude相同的计算，黄经不做0~360的归一化
+        template <class Dummy>
+        template <class T>
+        bounded_t<T> impl<Dummy>::get_moon_ecliptic_longitude_bounded(T jd) {
+            typedef real_traits<T> R;
+            static const REAL E[] = { 3.81034392032, 8.39968473021E+03, -3.31919929753E-05, 3.20170955005E-08, -1.53637455544E-10 };
+            static const REAL P[] = { 50287.92262, 111.24406, 0.07699, -0.23479, -0.00178, 0.00018, 0.00001 };
+            const T u = R::unit_roundoff;
+
+            const T d = jd - (T)JD2000;
+            const T t = d / 36525, at = R::abs(t);
+
+            bounded_t<T> L0 = elp2000_periodic_terms_bounded<T>(M10, sizeof(M10) / sizeof(*M10), t);
+            bounded_t<T> L1 = elp2000_periodic_terms_bounded<T>(M11, sizeof(M11) / sizeof(*M11), t);
+            bounded_t<T> L2 = elp2000_periodic_terms_bounded<T>(M12, sizeof(M12) / sizeof(*M12), t);
+
+            T l = L0.value + (L1.value + L2.value * t) * t;
+            T err = L0.err + (L1.err + L2.err * at) * at;
+            err += (R::abs(L0.value) + (R::abs(L1.value) + R::abs(L2.value) * at) * at) * 4 * u;
+            l *= (T)(RADIAN_PER_DEGREE / 3600);
+            err = (err + R::abs(l) * 2 * u) * (T)(RADIAN_PER_DEGREE / 3600);
+
+            // 月球平黄经
+            const T m = (T)E[0] + ((T)E[1] + ((T)E[2] + ((T)E[3] + (T)E[4] * t) * t) * t) * t;
+            const T mag = R::abs((T)E[0]) + (R::abs((T)E[1]) + (R::abs((T)E[2]) + (R::abs((T)E[3]) + R::abs((T)E[4]) * at) * at) * at) * at;
+            l += m;
+            err += (mag * 8 + R::abs(l)) * u;
+
+            // 岁差
+            const T t2 = d / 365250, at2 = R::abs(t2);
+            T t0 = 1, v = 0, vmag = 0;
+            for (auto i : P) {
+                t0 *= t2;
+                v += (T)i * t0;
+                vmag += R::abs((T)i) * R::abs(t0);
+            }
+            v = (v + (T)2.9965 * t2) * (T)(RADIAN_PER_DEGREE / 3600);
+            l += v;
+            err += ((vmag + 3 * at2) * (T)(RADIAN_PER_DEGREE / 3600) * 16 + R::abs(l)) * u;
+
+            return { l * (T)DEGREE_PER_RADIAN, (err + R::abs(l) * u) * (T)DEGREE_PER_RADIAN };
+        }
+
         // 世界时与原子时之差计算表
         template <class Dummy>
         const delta_time_t impl<Dummy>::D[] = {
@@ -611,20 +1166,25 @@ namespace astronomy {
             {  1980,     51.0,      1.29,  -0.026,  0.0032 },
             {  2000,     64.7,     -1.66,   5.224, -0.2905 },
             {  2150,    279.4,    732.95, 429.579,  0.0158 },
-            {  6000 },
+            {  6000, 0, 0, 0, 0 },
         };
 
-        // 传入儒略日(JD2000起算),计算UTC与原子时的差(单位:日)
+        // 儒略日(JD2000起算)所用的D[]中的段，超出表的范围时取最后一段
         template <class Dummy>
-        REAL impl<Dummy>::calc_delta_t(REAL t) {
+        std::size_t impl<Dummy>::delta_t_segment(REAL t) {
             const REAL y = t / 365.2425 + 2000;
 
             constexpr std::size_t length = sizeof(D) / sizeof(*D);
-            const delta_time_t *p = D;
-            for (std::size_t i = 0; i + 1 < length; ++i) {
-                p = D + i;
-                if (y < p[1].y) break;
-            }
+            std::size_t i = 0;
+            while (i + 2 < length && y >= D[i + 1].y) ++i;
+            return i;
+        }
+
+        // 传入儒略日(JD2000起算),计算UTC与原子时的差(单位:日)
+        template <class Dummy>
+        REAL impl<Dummy>::calc_delta_t(REAL t) {
+            const REAL y = t / 365.2425 + 2000;
+            const delta_time_t *p = D + delta_t_segment(t);
 
             const REAL t1 = (y - p->y) / (p[1].y - p->y - 0.0) * 10;
             const REAL d = p->a0 + (p->a1 + (p->a2 + p->a3 * t1) * t1) * t1;
@@ -635,47 +1195,120 @@ namespace astronomy {
 
     typedef detail::impl<int> impl;
 
-    static REAL make_julian_day(int year, int month, int day, int hour, int minute, REAL second) {
-        if (month <= 2) {
-            month += 12;
-            --year;
-        }
-        int B = year / 400 - year / 100;
-        REAL a = 365.25 * year;
-        REAL b = 30.6001 * (month + 1);
-        return floor(a) + floor(b) + B + 1720996.5 + day + hour / 24.0 + minute / 1440.0 + second / 86400.0;
+    // 日期与日序的换算全部用整数运算
+    // 截断除法只对非负数正确，所以先把年份平移若干个整周期（儒略历4年、公历400年）再算
+    namespace detail {
+        static constexpr int JULIAN_SHIFT_YEARS = 4000;  // 可支持到约公元前8700年
+        static constexpr int JULIAN_SHIFT_DAYS = JULIAN_SHIFT_YEARS / 4 * 1461;
+        static constexpr int GREGORIAN_SHIFT_YEARS = 8000;
+        static constexpr int GREGORIAN_SHIFT_DAYS = GREGORIAN_SHIFT_YEARS / 400 * 146097;
+        static constexpr day_number_t GREGORIAN_START = 2299161;  // 1582-10-15
     }
 
-    static REAL calc_delta_t(REAL jd) {
-        return impl::calc_delta_t(jd - astronomy::JD2000);
+    // 外推公历，年份为天文纪年（有0年）
+    static day_number_t day_number_from_gregorian(int year, int month, int day) {
+        const int a = (14 - month) / 12;  // 1、2月算作上一年的13、14月
+        const int y = year + 4800 - a + detail::GREGORIAN_SHIFT_YEARS;
+        const int m = month + 12 * a - 3;
+        return day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045 - detail::GREGORIAN_SHIFT_DAYS;
     }
 
-    static void daytime_from_julian_day(REAL jd, daytime_t *p) {
-        const REAL jdf = jd + 0.5;
-        int a = (int)(jdf);
-        REAL f = jdf - a;
+    // 历史纪年：1582-10-15起为公历，之前为儒略历；年份与daytime_t相同，无0年，公元前1年为-1
+    static day_number_t day_number_from_civil(int year, int month, int day) {
+        const int astro = year + (year < 0);
+        const int a = (14 - month) / 12;
+        const int y = astro + 4800 - a;
+        const int m = month + 12 * a - 3;
+        const int base = day + (153 * m + 2) / 5 + 365 * y;
+
+        const int julian = base + (y + detail::JULIAN_SHIFT_YEARS) / 4 - detail::JULIAN_SHIFT_YEARS / 4 - 32083;
+        const int gregorian = base + y / 4 - y / 100 + y / 400 - 32045;
+        const int greg = ((astro * 16 + month) * 32 + day) >= ((1582 * 16 + 10) * 32 + 15);
+        return greg ? gregorian : julian;
+    }
+
+    // Richards算法，公历部分先折算成儒略历再统一分解
+    static void civil_from_day_number(day_number_t n, int *year, int *month, int *day) {
+        const int greg = n >= detail::GREGORIAN_START;
+        const int f = n + 1401 + greg * ((((4 * n + 274277) / 146097) * 3) / 4 - 38) + detail::JULIAN_SHIFT_DAYS;
+        const int e = 4 * f + 3;
+        const int h = 5 * ((e % 1461) / 4) + 2;
+        const int m = (h / 153 + 2) % 12 + 1;
+        const int y = e / 1461 - 4716 + (14 - m) / 12 - detail::JULIAN_SHIFT_YEARS;
+
+        *day = (h % 153) / 5 + 1;
+        *month = m;
+        *year = y - (y < 1);
+    }
+
+    // 外推公历，与day_number_from_gregorian相反，年份为天文纪年
+    static inline void gregorian_from_day_number(day_number_t n, int *year, int *month, int *day) {
+        n += detail::GREGORIAN_SHIFT_DAYS;
+        const int f = n + 1401 + (((4 * n + 274277) / 146097) * 3) / 4 - 38;
+        const int e = 4 * f + 3;
+        const int h = 5 * ((e % 1461) / 4) + 2;
+        const int m = (h / 153 + 2) % 12 + 1;
+
+        *day = (h % 153) / 5 + 1;
+        *month = m;
+        *year = e / 1461 - 4716 + (14 - m) / 12 - detail::GREGORIAN_SHIFT_YEARS;
+    }
+
+    // 批量换算，只用到daytime_t的年月日
+    static inline void day_numbers_from_civil(const daytime_t *dt, std::size_t n, day_number_t *out) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = day_number_from_civil(dt[i].year, dt[i].month, dt[i].day);
+        }
+    }
+
+    static inline void civil_from_day_numbers(const day_number_t *dn, std::size_t n, daytime_t *out) {
+        for (std::size_t i = 0; i < n; ++i) {
+            civil_from_day_number(dn[i], &out[i].year, &out[i].month, &out[i].day);
+            out[i].hour = 0;
+            out[i].minute = 0;
+            out[i].second = 0;
+        }
+    }
+
+    // 干支日序，0为甲子（2000-01-01为戊午，即54）
+    static int sexagenary_day(day_number_t n) {
+        const int r = (n + 49) % 60;
+        return r + (r < 0) * 60;
+    }
 
-        int cnd;
-        if (a > 2299161) {
-            cnd = (int)((a - 1867216.25) / 36524.25);
-            a = a + 1 + cnd - (int)(cnd / 4);
+    static inline void sexagenary_days(const day_number_t *dn, std::size_t n, int *out) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = sexagenary_day(dn[i]);
         }
-        a = a + 1524;
+    }
+
+    // 历史纪年（同day_number_from_civil：1582-10-15之前为儒略历，无0年）的日期与时刻，解析输入的日期都用这个
+    static inline REAL julian_day_from_civil(int year, int month, int day, int hour, int minute, REAL second) {
+        return day_number_from_civil(year, month, day) - 0.5 + hour / 24.0 + minute / 1440.0 + second / 86400.0;
+    }
+
+    // 外推公历，年份为天文纪年
+    static REAL make_julian_day(int year, int month, int day, int hour, int minute, REAL second) {
+        return day_number_from_gregorian(year, month, day) - 0.5 + hour / 24.0 + minute / 1440.0 + second / 86400.0;
+    }
 
-        int year = (int)((a - 122.1) / 365.25);
-        cnd = a - (int)(365.25 * year);
+    static REAL calc_delta_t(REAL jd) {
+        return impl::calc_delta_t(jd - astronomy::JD2000);
+    }
 
-        int month = (int)(cnd / 30.6001);
-        p->day = cnd - (int)(month * 30.6001);
+    // 儒略日jd的ΔT取自impl::D的第几段（impl::D[i] ~ impl::D[i + 1].y）
+    static inline std::size_t get_delta_t_segment(REAL jd) {
+        return impl::delta_t_segment(jd - astronomy::JD2000);
+    }
 
-        year -= 4716;
-        month -= 1;
-        if (month > 12) month -= 12;
-        if (month <= 2) year += 1;
-        if (year < 1) year = year - 1;
+    // 返回该时刻所在日的日序
+    static inline day_number_t daytime_from_julian_day(REAL jd, daytime_t *p) {
+        const REAL jdf = jd + 0.5;
+        const REAL a = std::floor(jdf);
+        const day_number_t n = (day_number_t)a;
+        REAL f = jdf - a;
 
-        p->year = year;
-        p->month = month;
+        civil_from_day_number(n, &p->year, &p->month, &p->day);
 
         f *= 24.0;
         p->hour = (int)(f);
@@ -686,6 +1319,7 @@ namespace astronomy {
         f -= p->minute;
 
         p->second = f * 60.0;
+        return n;
     }
 
     static inline REAL calc_moon_ecliptic_longitude(REAL jd) {
@@ -699,6 +1333,55 @@ namespace astronomy {
     static inline REAL get_sun_ecliptic_longitude(REAL jd) {
         return impl::get_sun_ecliptic_longitude(jd);
     }
+
+    // 月球地心黄纬，单位为度
+    static inline REAL get_moon_ecliptic_latitude(REAL jd) {
+        return impl::calc_moon_latitude((jd - JD2000) / 36525) * detail::DEGREE_PER_RADIAN;
+    }
+
+    template <class T>
+    using bounded_t = detail::bounded_t<T>;
+
+    template <class T>
+    using real_traits = detail::real_traits<T>;
+
+    template <class T>
+    static inline bounded_t<T> get_moon_ecliptic_longitude_bounded(T jd) {
+        return impl::get_moon_ecliptic_longitude_bounded<T>(jd);
+    }
+
+    template <class T>
+    static inline bounded_t<T> get_sun_ecliptic_longitude_bounded(T jd) {
+        return impl::get_sun_ecliptic_longitude_bounded<T>(jd);
+    }
+
+    static inline double get_moon_ecliptic_longitude_lite(REAL jd, double &err) {
+        return impl::get_moon_ecliptic_longitude_lite(jd, err);
+    }
+
+    static inline double get_sun_ecliptic_longitude_lite(REAL jd, double &err) {
+        return impl::get_sun_ecliptic_longitude_lite(jd, err);
+    }
+
+    // 黄经章动与交角章动，单位为度
+    static inline void get_nutation(REAL jd, REAL *longitude, REAL *obliquity) {
+        impl::calc_nutation(jd - JD2000, *longitude, *obliquity);
+        *longitude *= detail::DEGREE_PER_RADIAN;
+        *obliquity *= detail::DEGREE_PER_RADIAN;
+    }
+
+    // 平黄赤交角，单位为度
+    static inline REAL get_mean_obliquity(REAL jd) {
+        return impl::calc_mean_obliquity(jd - JD2000) * detail::DEGREE_PER_RADIAN;
+    }
+
+    static inline void get_moon_ecliptic_longitude_grid(REAL jd0, REAL step, std::size_t n, double *out) {
+        impl::get_moon_ecliptic_longitude_grid(jd0, step, n, out);
+    }
+
+    static inline void get_sun_ecliptic_longitude_grid(REAL jd0, REAL step, std::size_t n, double *out) {
+        impl::get_sun_ecliptic_longitude_grid(jd0, step, n, out);
+    }
 }
 
 #endif
@@ -1,233 +1,100 @@
-﻿#include "astronomy.h"
+﻿// 命令行工具，编译：
+//   g++ -std=c++14 -O2 -o calendar calendar.cpp -lquadmath -pthread
+// 没有libquadmath时加-DASTRONOMY_NO_FLOAT128并去掉-lquadmath，证明档（--mode certified）的最高一级精度改为long double
+#include "calendar.h"
+#include "context.h"
+#include "eclipse.h"
+#include "event_db.h"
+#include "festivals.h"
+#include "four_pillars.h"
+#include "ics.h"
+#include "incremental.h"
+#include "packed_years.h"
+#include "pipeline.h"
+#include "query.h"
+#include "server.h"
+#include "shard.h"
+#include "sun_times.h"
+#include "year_cache.h"
 #include <stdio.h>
-
-static astronomy::REAL estimate_solar_term(int year, int angle) {
-    int month = (angle + 105) / 30;
-    if (month > 12) month -= 12;
-    if (angle % 30 == 0) {
-        return astronomy::make_julian_day(year, month, month < 8 ? 20 : 22, 0, 0, 0.0);
-    }
-    else {
-        return astronomy::make_julian_day(year, month, month < 8 ? 4 : 7, 0, 0, 0.0);
-    }
-}
-
-static astronomy::REAL calc_solar_term(int year, int idx) {
-    constexpr static astronomy::REAL step = 0.000005;
-    constexpr static astronomy::REAL step2 = step * 2;
-
-    astronomy::REAL JD0, JD1, D, Dp;
-    int angle = idx * 15;
-    JD1 = estimate_solar_term(year, angle);
-    do {
-        JD0 = JD1;
-        D = astronomy::get_sun_ecliptic_longitude(JD0);
-        D = ((angle == 0) && (D > 345.0)) ? D - 360.0 : D;
-
-        Dp = (astronomy::get_sun_ecliptic_longitude(JD0 + step) - astronomy::get_sun_ecliptic_longitude(JD0 - step)) / step2;
-        JD1 = JD0 - (D - angle) / Dp;
-    } while ((fabs(JD1 - JD0) > 1e-8));
-
-    return JD0;
-}
-
-static astronomy::REAL clamp_degrees(astronomy::REAL d) {
-    while (d < 0) d += 360;
-    while (d > 360) d -= 360;
-    return d;
-}
-
-static astronomy::REAL ecliptic_longitude_diff(astronomy::REAL jd) {
-    return clamp_degrees(astronomy::get_moon_ecliptic_longitude(jd) - astronomy::get_sun_ecliptic_longitude(jd));
-};
-
-static astronomy::REAL estimate_new_moon_forward(astronomy::REAL jd) {
-    astronomy::REAL D0, D1;
-    D0 = ecliptic_longitude_diff(jd);
-    for (int i = 1; i < 30; ++i) {
-        jd += 1;
-        D1 = ecliptic_longitude_diff(jd);
-        if (D1 < D0) {
-            jd -= 1;
-            break;
-        }
-        D0 = D1;
-    }
-    return jd;
-}
-
-static astronomy::REAL estimate_new_moon_backward(astronomy::REAL jd) {
-    constexpr astronomy::REAL ONE_DAY = 360.0 / 29.53;
-    constexpr astronomy::REAL ONE_DAY_RVS = 1 / ONE_DAY;
-
-    astronomy::REAL D0, D1;
-    D0 = ecliptic_longitude_diff(jd);
-
-    if (D0 > ONE_DAY) {
-        jd -= D0 * ONE_DAY_RVS;
-        D1 = ecliptic_longitude_diff(jd);
-        if (D1 > D0) {
-            do {
-                jd += 1;
-                D1 = ecliptic_longitude_diff(jd);
-            } while (D1 > D0);
-            return jd - 1;
-        }
-        else if (D1 < D0) {
-            D0 = D1;
-            do {
-                jd -= 1;
-                D1 = ecliptic_longitude_diff(jd);
-            } while (D1 < D0);
-            return jd;
-        }
-
-        return jd;
-    }
-
-    for (int i = 1; i < 30; ++i) {
-        jd -= 1;
-        D1 = ecliptic_longitude_diff(jd);
-        if (D1 > D0) {
-            break;
-        }
-        D0 = D1;
-    }
-
-    return jd;
-}
-
-static astronomy::REAL calc_new_moon_nearby(astronomy::REAL jd) {
-    constexpr static astronomy::REAL step = 0.000005;
-    constexpr static astronomy::REAL step2 = step * 2;
-
-    astronomy::REAL JD0, JD1, D, Dp;
-    JD1 = jd;
-    do {
-        JD0 = JD1;
-        D = ecliptic_longitude_diff(JD0);
-        D = (D > 345.0) ? D - 360.0 : D;
-
-        Dp = (ecliptic_longitude_diff(JD0 + step) - ecliptic_longitude_diff(JD0 - step)) / step2;
-        JD1 = JD0 - D / Dp;
-    } while ((fabs(JD1 - JD0) > 1e-8));
-
-    return JD0;
-}
-
-static astronomy::REAL calc_new_moon_nearby(int year, int month, int day) {
-    return calc_new_moon_nearby(astronomy::make_julian_day(year, month, day, 0, 0, 0));
-}
-
-static constexpr const char *solar_terms_names[] = {
-    "小寒", "大寒", "立春", "雨水", "驚蟄", "春分", "清明", "穀雨", "立夏", "小滿", "芒種", "夏至",
-    "小暑", "大暑", "立秋", "處暑", "白露", "秋分", "寒露", "霜降", "立冬", "小雪", "大雪", "冬至"
-};
-
-static constexpr const char *month_names[] = {
-    "正月", "二月", "三月", "四月", "五月", "六月", "七月", "八月", "九月", "十月", "冬月", "臘月",
-};
-
-static constexpr const char *day_names[] = {
-    "初一", "初二", "初三", "初四", "初五", "初六", "初七", "初八", "初九", "初十",
-    "十一", "十二", "十三", "十四", "十五", "十六", "十七", "十八", "十九", "二十",
-    "廿一", "廿二", "廿三", "廿四", "廿五", "廿六", "廿七", "廿八", "廿九", "三十",
-};
-
-static constexpr const char *celestial_stems[10] = {
-    "甲", "乙", "丙", "丁", "戊", "己", "庚", "辛", "壬", "癸"
-};
-
-static constexpr const char *terrestrial_branches[12] = {
-    "子", "丑", "寅", "卯", "辰", "巳", "午", "未", "申", "酉", "戌", "亥"
-};
-
-// NOTE: 1928年及之前的农历用北京地方时116°23′E，1929年开始使用120°E平太阳时
-// (116+23/60)*4*60=(465+8/15)*60=27932
-static constexpr astronomy::REAL TIMEZONE_BEIJING = 8.0 / 24.0;
-static constexpr astronomy::REAL TIMEZONE_BEIJING_LOCAL = 27932.0 / 86400.0;
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
 
 static void print_daytime(const astronomy::daytime_t &dt) {
 #if 1
     if ((dt.hour != 0 || dt.minute > 30) && (dt.hour != 23 || dt.minute < 30)) {
-        printf("%.2d-%.2d %.2d:%.2d:%06.3f  ", dt.month, dt.day, dt.hour, dt.minute, dt.second);
+        printf("%.2d-%.2d %.2d:%.2d:%06.3f  ", dt.month, dt.day, dt.hour, dt.minute, (double)dt.second);
     }
     else {
-        printf("%.2d-%.2d %.2d:%.2d:%06.3f *", dt.month, dt.day, dt.hour, dt.minute, dt.second);
+        printf("%.2d-%.2d %.2d:%.2d:%06.3f *", dt.month, dt.day, dt.hour, dt.minute, (double)dt.second);
     }
 #else
     printf("%.2d-%.2d", dt.month, dt.day);
 #endif
 }
 
-static void print_daytime_cstb(const astronomy::daytime_t &dt) {
-    int y = dt.year, m = dt.month, d = dt.day;
-    if (m == 1 || m == 2) {
-        m += 12;
-        --y;
-    }
-    int n = (y * 5 + (y >> 2) - y / 100 + y / 400 + ((m - 1) & 1) * 30 + (((m - 2) * 19) >> 5) + d + 8) % 60;
-    printf("%s%s", celestial_stems[n % 10], terrestrial_branches[n % 12]);
+static void print_daytime_cstb(astronomy::day_number_t dn) {
+    int n = astronomy::sexagenary_day(dn);
+    printf("%s%s", calendar::celestial_stems[n % 10], calendar::terrestrial_branches[n % 12]);
 }
 
 static int days_offset(const astronomy::daytime_t &dt) {
-    int y = dt.year, m = dt.month, d = dt.day;
-    if (m < 3) {
-        m += 12;
-        --y;
-    }
-    return y * 365 + (y >> 2) - y / 100 + y / 400 + (m - 3) * 30 + (((m - 2) * 19) >> 5) + d;
+    return astronomy::day_number_from_civil(dt.year, dt.month, dt.day);
 }
 
 // NOTE: 一种朴素的想法，直接计算0点与24点，如果这两个时刻的值会跳转，说明节气、朔在该日
 // 然而，julian_day 是有偏差的，无法反算
-static void calc_solar_term_for_year(int y) {
-    const astronomy::REAL tz = y >= 1929 ? TIMEZONE_BEIJING : TIMEZONE_BEIJING_LOCAL;
+static void calc_solar_term_for_year(int y, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
+    const astronomy::REAL tz = calendar::timezone_offset(rule, y);
     astronomy::daytime_t dt;
 
     printf("// %.2d :", y % 100);
     for (int i = 0; i < 24; ++i) {
-        astronomy::REAL jd = calc_solar_term(y, i >= 5 ? i - 5 : i + 19) + tz;
+        astronomy::REAL jd = calendar::calc_solar_term(y, i >= 5 ? i - 5 : i + 19) + tz;
         astronomy::daytime_from_julian_day(jd - astronomy::calc_delta_t(jd), &dt);
         printf(" %d", dt.day);
     }
     printf("\n");
 }
 
-static void calc_solar_term_for_year_full(int y) {
+static void calc_solar_term_for_year_full(int y, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
     printf("// %.2d :\n", y % 100);
-    const astronomy::REAL tz = y >= 1929 ? TIMEZONE_BEIJING : TIMEZONE_BEIJING_LOCAL;
+    const astronomy::REAL tz = calendar::timezone_offset(rule, y);
     astronomy::daytime_t dt;
 
     for (int i = 0; i < 24; ++i) {
-        astronomy::REAL jd = calc_solar_term(y, i >= 5 ? i - 5 : i + 19) + tz;
+        astronomy::REAL jd = calendar::calc_solar_term(y, i >= 5 ? i - 5 : i + 19) + tz;
         astronomy::daytime_from_julian_day(jd - astronomy::calc_delta_t(jd), &dt);
 
-        printf("%s : ", solar_terms_names[i]);
+        printf("%s : ", calendar::solar_terms_names[i]);
         print_daytime(dt);
         printf("\n");
     }
     printf("\n\n");
 }
 
-static void calc_new_moon_for_year_full(int y) {
-    const astronomy::REAL tz = y >= 1929 ? TIMEZONE_BEIJING : TIMEZONE_BEIJING_LOCAL;
+static void calc_new_moon_for_year_full(int y, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
+    const astronomy::REAL tz = calendar::timezone_offset(rule, y);
     astronomy::daytime_t dt;
 
     astronomy::REAL jd = astronomy::make_julian_day(y, 1, 1, 0, 0, 0.0) + tz;
-    jd = calc_new_moon_nearby(estimate_new_moon_forward(jd));
+    jd = calendar::calc_new_moon_nearby(calendar::estimate_new_moon_forward(jd));
 
     astronomy::daytime_from_julian_day(jd + tz - astronomy::calc_delta_t(jd + tz), &dt);
-    printf("%.2d-%.2d %.2d:%.2d:%06.3f\n", dt.month, dt.day, dt.hour, dt.minute, dt.second);
+    printf("%.2d-%.2d %.2d:%.2d:%06.3f\n", dt.month, dt.day, dt.hour, dt.minute, (double)dt.second);
 
     unsigned bit = dt.day << 12;
     int offset = days_offset(dt);
 
     for (int i = 0; i < 13; ++i) {
-        jd = calc_new_moon_nearby(jd + 29.53);
+        jd = calendar::calc_new_moon_nearby(jd + 29.53);
 
         astronomy::daytime_from_julian_day(jd + tz - astronomy::calc_delta_t(jd + tz), &dt);
-        printf("%.2d-%.2d %.2d:%.2d:%06.3f\n", dt.month, dt.day, dt.hour, dt.minute, dt.second);
+        printf("%.2d-%.2d %.2d:%.2d:%06.3f\n", dt.month, dt.day, dt.hour, dt.minute, (double)dt.second);
 
         if (dt.year == y) {
             int o = days_offset(dt);
@@ -241,319 +108,421 @@ static void calc_new_moon_for_year_full(int y) {
     printf("0x%05x\n", bit);
 }
 
-#define DISPLAY_AS_CSTB 1
-
-static void calc_chn_cal(int y) {
-    constexpr int WINTER_SOLSTICE_INDEX = 23 - 5;
-    const astronomy::REAL tz = y >= 1929 ? TIMEZONE_BEIJING : TIMEZONE_BEIJING_LOCAL;
+static void calc_moon_phase_for_year_full(int y, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
+    const astronomy::REAL tz = calendar::timezone_offset(rule, y);
 
-    struct MyDayTime {
+    printf("// %.2d :\n", y % 100);
+    calendar::calc_moon_phases_for_year(y, tz, [tz](const calendar::moon_phase_t &mp) {
         astronomy::daytime_t dt;
-        int ofst;
-
-        void set(astronomy::REAL jd) {
-            astronomy::daytime_from_julian_day(jd - astronomy::calc_delta_t(jd), &dt);
-            ofst = days_offset(dt);
-        }
-    };
-
-
-    // 由于农历的置闰是以冬至为锚点的，11、12月是否闰取决于上一个周期，而1~10月是否闰取决于下一个周期
-    // 这里为了显示，把节气也显示出来，所以需要24*2，多出来的3是上一年的小雪、大雪、冬至
-    // 朔日需要本来只需要计算26个，又因为如果冬至离朔日很近的时候，可能迭代到上一个月的，加之腊月需要显示大小，故有28
-    MyDayTime solar_terms[51]{}, new_moons[28]{};
-
-    // 上年冬至、以及上年冬至之前的朔
-    astronomy::REAL jd_st = calc_solar_term(y - 1, WINTER_SOLSTICE_INDEX);
-    astronomy::REAL jd_nm = calc_new_moon_nearby(estimate_new_moon_backward(jd_st));
-    int st_idx = 2, nm_idx = 1;
-
+        astronomy::REAL jd = mp.jd + tz;
+        astronomy::daytime_from_julian_day(jd - astronomy::calc_delta_t(jd), &dt);
 
-    // 下标0和1是小雪、大雪，这两个有可能跟冬至在同一个月（概率较小）
-    // 下标0预留冬至之前的朔
-    solar_terms[2].set(jd_st + tz);
-    new_moons[1].set(jd_nm + tz);
+        printf("%s : ", calendar::moon_phase_names[mp.phase]);
+        print_daytime(dt);
+        printf("\n");
+    });
+    printf("\n\n");
+}
 
-    // 如果朔比冬至大，则说明迭代到下一个月的朔了，需要检查更早一个朔
-    if (new_moons[1].ofst > solar_terms[2].ofst) {
-        astronomy::REAL jd_tmp = calc_new_moon_nearby(jd_nm - 29.53);
-        new_moons[0].set(jd_tmp + tz);
-        if (new_moons[0].ofst < solar_terms[2].ofst) {
-            nm_idx = 0;
-        }
-    }
-    else {
-        astronomy::REAL jd_tmp = calc_new_moon_nearby(jd_nm + 29.53);
-        new_moons[2].set(jd_tmp + tz);
-        if (new_moons[2].ofst == solar_terms[2].ofst) {
-            new_moons[1] = new_moons[2];
-            jd_nm = jd_tmp;
+// 从某日起按时间顺序显示节气与月相，count为负时向前
+// mode不是CALC_FULL时用低精度档求解，时刻有数秒误差，误差区间跨越日界的改用全精度解，所在日与全精度档相同
+static void print_events(int year, int month, int day, int count, calendar::calc_mode_t mode = calendar::CALC_FULL, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
+    const astronomy::REAL tz = calendar::timezone_offset(rule, year);
+    astronomy::REAL jd = astronomy::julian_day_from_civil(year, month, day, 0, 0, 0.0) - tz;
+    jd += astronomy::calc_delta_t(jd);
+
+    calendar::event_stream stream(jd, calendar::EVENTS_ALL, count >= 0, mode);
+    for (int i = 0, n = count >= 0 ? count : -count; i < n; ++i) {
+        calendar::astro_event_t e = stream.next();
+        if (mode != calendar::CALC_FULL && calendar::straddles_day_boundary({ e.jd, e.err }, tz)) {
+            e.jd = e.type == calendar::EVENT_SOLAR_TERM ? calendar::calc_solar_term_nearby(e.jd, e.angle) : calendar::calc_moon_phase_nearby(e.jd, e.angle);
         }
+        astronomy::daytime_t dt;
+        astronomy::REAL local = e.jd + tz;
+        astronomy::daytime_from_julian_day(local - astronomy::calc_delta_t(local), &dt);
+        printf("%s : ", e.type == calendar::EVENT_SOLAR_TERM ? calendar::solar_terms_names[e.index] : calendar::moon_phase_names[e.index]);
+        print_daytime(dt);
+        printf("\n");
     }
+}
 
-    // 上年小雪、大雪
-    for (int i = 0; i < 2; ++i) {
-        jd_st = calc_solar_term(y - 1, (WINTER_SOLSTICE_INDEX + 22 + i) % 24);
-        solar_terms[i].set(jd_st + tz);
+// 逐日显示：公历日期 农历月日 干支日 节气
+static void print_days(int year, int month, int day, int count, calendar::calc_mode_t mode = calendar::CALC_ADAPTIVE, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
+    const astronomy::day_number_t first = astronomy::day_number_from_civil(year, month, day);
+    for (const auto &r : calendar::day_range(first, first + count, mode, rule)) {
+        printf("%d-%.2d-%.2d %s%s%s ", r.year, r.month, r.mday, r.leap ? "閏" : "", calendar::month_names[r.lunar_month - 1], calendar::day_names[r.lunar_day - 1]);
+        print_daytime_cstb(r.day);
+        if (r.solar_term >= 0) printf(" %s", calendar::solar_terms_names[r.solar_term]);
+        printf("\n");
     }
+}
 
-    // 上年冬至~今年冬至
-    for (int i = 0; i < 24; ++i) {
-        jd_st = calc_solar_term(y, i >= 5 ? i - 5 : i + 19);
-        solar_terms[i + 3].set(jd_st + tz);
+// 显示四柱，时间为rule所指的当地时间
+// solar_longitude非空时日柱、时柱按该东经处的真太阳时排，并显示真太阳时；年柱、月柱仍按节气的实际时刻
+static void print_four_pillars(const astronomy::daytime_t *dts, int count, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA,
+    const double *solar_longitude = nullptr) {
+    std::vector<astronomy::REAL> local(count);
+    for (int i = 0; i < count; ++i) {
+        local[i] = astronomy::julian_day_from_civil(dts[i].year, dts[i].month, dts[i].day, dts[i].hour, dts[i].minute, dts[i].second);
     }
-
-    // 今年冬至~次年冬至
-    for (int i = 0; i < 24; ++i) {
-        jd_st = calc_solar_term(y + 1, i >= 5 ? i - 5 : i + 19);
-        solar_terms[i + 27].set(jd_st + tz);
+    std::vector<calendar::four_pillars_t> fp(count);
+    calendar::calc_four_pillars_bulk(local.data(), count, fp.data(), rule);
+
+    // 所有时刻共用一次星历计算，覆盖最早至最晚的UT日
+    std::vector<astronomy::REAL> solar;
+    if (solar_longitude != nullptr && count > 0) {
+        std::vector<astronomy::REAL> ut(count);
+        for (int i = 0; i < count; ++i) ut[i] = local[i] - calendar::timezone_offset(rule, dts[i].year + (dts[i].year < 0));
+        const auto range = std::minmax_element(ut.begin(), ut.end());
+        const calendar::sun::ephemeris eph((astronomy::day_number_t)std::floor(*range.first + 0.5), (astronomy::day_number_t)std::floor(*range.second + 0.5));
+        solar.resize(count);
+        for (int i = 0; i < count; ++i) {
+            solar[i] = calendar::sun::true_solar_time(eph, ut[i], *solar_longitude);
+            calendar::set_solar_day_hour_pillars(solar[i], fp[i]);
+        }
     }
 
-    // 朔
-    for (int i = 2; i < 28; ++i) {
-        jd_nm = calc_new_moon_nearby(jd_nm + 29.53);
-        new_moons[i].set(jd_nm + tz);
+    for (int i = 0; i < count; ++i) {
+        print_daytime(dts[i]);
+        if (!solar.empty()) {
+            astronomy::daytime_t st;
+            astronomy::daytime_from_julian_day(solar[i], &st);
+            print_daytime(st);
+        }
+        printf(" ");
+        const int p[4] = { fp[i].year, fp[i].month, fp[i].day, fp[i].hour };
+        for (int k = 0; k < 4; ++k) {
+            printf("%s%s ", calendar::celestial_stems[p[k] % 10], calendar::terrestrial_branches[p[k] % 12]);
+        }
+        printf("\n");
     }
+}
 
-    printf("%d\n", y);
+#define DISPLAY_AS_CSTB 1
+
+static void print_chn_cal(const calendar::lunar_year_t &ly) {
+    printf("%d\n", ly.year);
 
 #if 0
     printf("solar terms:\n");
-    for (const auto &st : solar_terms) {
-        print_daytime(st.dt);
+    for (int i = 0; i < ly.term_count; ++i) {
+        astronomy::daytime_t dt;
+        astronomy::daytime_from_julian_day(ly.terms[i].local, &dt);
+        print_daytime(dt);
         printf("\n");
     }
 
     printf("new moons:\n");
-    for (int i = nm_idx; i < 28; ++i) {
-        print_daytime(new_moons[i].dt);
+    for (int i = 0; i < ly.month_count; ++i) {
+        astronomy::daytime_t dt;
+        astronomy::daytime_from_julian_day(ly.months[i].local, &dt);
+        print_daytime(dt);
         printf("\n");
     }
 #endif
 
-    int leap = 0;
-
-    // 闰月在上年冬至~今年冬至区间
-    // solar_terms[26]为今年冬至
-    if (solar_terms[26].ofst >= new_moons[nm_idx + 13].ofst) {
-        int ms_idx = 2, o;
-        for (int i = 0; i < 13; ++i) {
-            o = solar_terms[ms_idx].ofst;
-            if (new_moons[nm_idx + i + 1].ofst <= o) {
-                leap = nm_idx + i;
-                break;
-            }
-            ms_idx += 2;
-        }
-    }
-    // 闰月在今年冬至~下年冬至区间
-    // solar_terms[50]为下年冬至
-    else if (solar_terms[50].ofst >= new_moons[nm_idx + 25].ofst) {
-        int ms_idx = 26, o;
-        for (int i = 0; i < 13; ++i) {
-            o = solar_terms[ms_idx].ofst;
-            if (new_moons[nm_idx + i + 13].ofst <= o) {
-                leap = nm_idx + i + 12;
-                break;
-            }
-            ms_idx += 2;
-        }
-    }
-
-    st_idx = 0;
-
-    while (nm_idx < 16) {
-        const auto &mn0 = new_moons[nm_idx];
-        const auto &mn1 = new_moons[nm_idx + 1];
-        bool major = (mn1.ofst - mn0.ofst) == 30;
-
-        int readable;
-        if (leap == 0 || nm_idx < leap) {
-            // 无闰、或本月在闰月之前
-            readable = (nm_idx + 9) % 12 + 1;
-        }
-        else {
-            // 有闰且本月在闰月或者之后
-            readable = (nm_idx + 8) % 12 + 1;
-        }
-
-#if 0
-        // 按岁显示
-        if (nm_idx > (leap == 0 || nm_idx <= leap ? 13 : 14)) {
-            break;
-        }
-#endif
-
-#if 1
-        // 按年显示
-        if (leap == 0 ? (nm_idx < 3 || nm_idx > 14) : (nm_idx < (leap >= 4 ? 3 : 4) || nm_idx > (leap <= 15 ? 15 : 14))) {
-            ++nm_idx;
-            continue;
-        }
-#endif
+    int st_idx = 0;
 
+    for (int i = 0; i < ly.month_count; ++i) {
+        const auto &m = ly.months[i];
+        const astronomy::day_number_t next = i + 1 < ly.month_count ? ly.months[i + 1].first_day : ly.end_day;
 
 #if DISPLAY_AS_CSTB
         // 汉字方式显示月份 天支日期
-        printf("%s%s%s ", leap == 0 || nm_idx != leap ? "　" : "閏", month_names[readable - 1], major ? "大" : "小");
-        print_daytime_cstb(mn0.dt);
+        printf("%s%s%s ", m.leap ? "閏" : "　", calendar::month_names[m.month - 1], m.major ? "大" : "小");
+        print_daytime_cstb(m.first_day);
+        if (m.ambiguous) printf("？");
 #else
+        astronomy::daytime_t dt;
+        astronomy::daytime_from_julian_day(m.local, &dt);
 #if 0
         // 数字方式显示月份
-        printf("%c", leap == 0 || nm_idx != leap ? ' ' : '+');
-        printf("%.2d ", readable);
-        printf("%c (", major ? '+' : '-');
-        print_daytime(mn0.dt);
+        printf("%c", m.leap ? '+' : ' ');
+        printf("%.2d ", m.month);
+        printf("%c (", m.major ? '+' : '-');
+        print_daytime(dt);
         printf(")");
 #endif
 
 #if 0
         // 汉字方式显示月份
-        printf("%s%s%s (", leap == 0 || nm_idx != leap ? "　" : "閏", month_names[readable - 1], major ? "大" : "小");
-        print_daytime(mn0.dt);
+        printf("%s%s%s (", m.leap ? "閏" : "　", calendar::month_names[m.month - 1], m.major ? "大" : "小");
+        print_daytime(dt);
         printf(")");
 #endif
 #endif
 
-        ++nm_idx;
-
-        // 显示节气
-        while (1) {
-            const auto &st = solar_terms[st_idx];
-
-            // 节气超过本月了
-            if (st.ofst >= mn1.ofst) {
-                break;
-            }
-
-            // 节气落在本月内
-            if (st.ofst >= mn0.ofst) {
+        // 显示落在本月内的节气
+        for (; st_idx < ly.term_count && ly.terms[st_idx].day < next; ++st_idx) {
+            const auto &st = ly.terms[st_idx];
 #if DISPLAY_AS_CSTB
-                printf(" %s", day_names[st.ofst - mn0.ofst]);
-                print_daytime_cstb(st.dt);
-                printf("%s", solar_terms_names[(st_idx + 21) % 24]);
+            printf(" %s", calendar::day_names[st.day - m.first_day]);
+            print_daytime_cstb(st.day);
+            printf("%s", calendar::solar_terms_names[st.index]);
 #else
-                printf(" %s (", solar_terms_names[(st_idx + 21) % 24]);
-                print_daytime(st.dt);
-                printf(")");
+            astronomy::daytime_t dt;
+            astronomy::daytime_from_julian_day(st.local, &dt);
+            printf(" %s (", calendar::solar_terms_names[st.index]);
+            print_daytime(dt);
+            printf(")");
 #endif
+            if (st.ambiguous) printf("？");
+        }
+
+        printf("\n");
+    }
+}
+
+static void calc_chn_cal(int y, calendar::calc_mode_t mode = calendar::CALC_FULL, const calendar::timezone_rule_t &rule = calendar::TIMEZONE_RULE_CHINA) {
+    calendar::lunar_year_t ly;
+    calendar::calc_lunar_year(y, ly, mode, rule);
+    print_chn_cal(ly);
+}
+
+// 连续多年经流水线计算，求解与输出重叠；stats为true时把各级的计数打印到stderr
+// cache_path非空时先查磁盘缓存，缓存中没有的各段连续年份经流水线计算，算出后追加到缓存
+static void print_chn_cal_range(int y0, int y1, calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule, int threads, bool stats, const char *cache_path) {
+    calendar::pipeline::options_t opt;
+    opt.solvers = threads;
+    std::vector<calendar::pipeline::stage_stats_t> result;
+    auto run = [&](int first, int last, calendar::year_cache::cache *cache) {
+        const auto r = calendar::pipeline::run(first, last, mode, rule, opt, [&](const calendar::lunar_year_t &ly) {
+            if (cache != nullptr) cache->store(ly.year, rule, mode, ly);
+            print_chn_cal(ly);
+        });
+        if (result.empty()) {
+            result = r;
+            return;
+        }
+        for (std::size_t i = 0; i < r.size(); ++i) {
+            result[i].items += r[i].items;
+            result[i].busy_seconds += r[i].busy_seconds;
+            result[i].wait_seconds += r[i].wait_seconds;
+        }
+    };
+
+    std::size_t hits = 0;
+    if (cache_path == nullptr) {
+        run(y0, y1, nullptr);
+    }
+    else {
+        calendar::year_cache::cache cache(cache_path);
+        calendar::lunar_year_t ly;
+        for (int y = y0; y <= y1;) {
+            if (cache.lookup(y, rule, mode, ly)) {
+                print_chn_cal(ly);
+                ++hits;
+                ++y;
+                continue;
             }
+            int last = y;
+            while (last < y1 && !cache.lookup(last + 1, rule, mode, ly)) ++last;
+            run(y, last, &cache);
+            y = last + 1;
+        }
+    }
+
+    if (!stats) return;
+    if (cache_path != nullptr) fprintf(stderr, "%-6s %8zu years\n", "cache", hits);
+    for (const auto &s : result) {
+        fprintf(stderr, "%-6s %8zu years %9.3f s busy %9.3f s waiting %10.1f years/s\n", s.name, s.items, s.busy_seconds, s.wait_seconds,
+            s.busy_seconds > 0 ? s.items / s.busy_seconds : 0.0);
+    }
+}
 
-            ++st_idx;
+// 从事件库读取农历年，库不存在时先生成，无法打开或生成时返回1
+static int print_lunar_years_from_db(const char *path, int y0, int y1, calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) {
+    calendar::event_db::database db;
+    if (!db.open(path)) {
+        if (!calendar::event_db::generate(path, y0 - 1, y1 + 2) || !db.open(path)) {
+            fprintf(stderr, "cannot open %s\n", path);
+            return 1;
         }
+    }
 
+    for (int y = y0; y <= y1; ++y) {
+        calendar::lunar_year_t ly;
+        db.lunar_year(y, ly, mode, rule);
+        printf("%d", y);
+        for (int i = 0; i < ly.month_count; ++i) {
+            printf(" %s%s", ly.months[i].leap ? "閏" : "", calendar::month_names[ly.months[i].month - 1]);
+            print_daytime_cstb(ly.months[i].first_day);
+        }
         printf("\n");
     }
-
+    return 0;
 }
 
-int main() {
-    //calc_new_moon_for_year_full(2024);
-    //calc_solar_term_for_year_full(2022);
-
-    //calc_solar_term_for_year_full(1900);
-    //calc_solar_term_for_year_full(1912);
-    //calc_solar_term_for_year_full(1913);
-    //calc_solar_term_for_year_full(1917);
-    //calc_solar_term_for_year_full(1923);
-    //calc_solar_term_for_year_full(1927);
-    //calc_solar_term_for_year_full(1928);
-    //calc_solar_term_for_year_full(1844);
-    //calc_solar_term_for_year_full(1846);
-    //calc_solar_term_for_year_full(1849);
-    //calc_solar_term_for_year_full(1850);
-    //calc_solar_term_for_year_full(1851);
-    //calc_solar_term_for_year_full(1855);
-    //calc_solar_term_for_year_full(1862);
-    //calc_solar_term_for_year_full(1864);
-    //calc_solar_term_for_year_full(1866);
-    //calc_solar_term_for_year_full(1867);
-    //calc_solar_term_for_year_full(1879);
-    //calc_solar_term_for_year_full(1883);
-    //calc_solar_term_for_year_full(1884);
-    //calc_solar_term_for_year_full(1886);
-    //calc_solar_term_for_year_full(1895);
-    //calc_solar_term_for_year_full(1898);
-    //calc_solar_term_for_year_full(1899);
-
-    //printf("===\n");
-    //for (int i = 1900; i < 2000; ++i) {
-    //    calc_solar_term_for_year(i);
-    //}
-    //for (int i = 1899; i >= 1799; --i) {
-    //    calc_solar_term_for_year(i);
-    //}
-    //calc_solar_term_for_year_full(2023);
-    //calc_solar_term_for_year_full(2024);
-    //calc_solar_term_for_year_full(2025);
-
-    //calc_new_moon_for_year_full(2032);
-    //calc_chn_cal(2033);
-    //calc_chn_cal(2034);
+// 对比中国、越南、韩国同一农历年各月的朔日，三者共用一次求解
+static void compare_timezones(int y, calendar::calc_mode_t mode = calendar::CALC_ADAPTIVE) {
+    const calendar::timezone_rule_t rules[] = {
+        calendar::TIMEZONE_RULE_CHINA, calendar::TIMEZONE_RULE_VIETNAM, calendar::TIMEZONE_RULE_KOREA
+    };
+    calendar::lunar_year_t ly[3];
+    calendar::calc_lunar_year_variants(y, rules, 3, ly, mode);
 
-#if 1
+    printf("%d\n", y);
+    for (int k = 0; k < 3; ++k) {
+        printf("%s:", rules[k].name);
+        for (int i = 0; i < ly[k].month_count; ++i) {
+            const auto &m = ly[k].months[i];
+            int yy, mm, dd;
+            astronomy::civil_from_day_number(m.first_day, &yy, &mm, &dd);
+            printf(" %s%s %d-%.2d", m.leap ? "閏" : "", calendar::month_names[m.month - 1], mm, dd);
+        }
+        printf("\n");
+    }
+}
+
+// 各闰月的样例，每组为闰年及其前后两年
+static void print_leap_month_samples(calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) {
     // 测试数据2262年 闰正月
-    calc_chn_cal(2261);
-    calc_chn_cal(2262);
-    calc_chn_cal(2263);
+    calc_chn_cal(2261, mode, rule);
+    calc_chn_cal(2262, mode, rule);
+    calc_chn_cal(2263, mode, rule);
 
     // 2023 闰二月
-    calc_chn_cal(2022);
-    calc_chn_cal(2023);
-    calc_chn_cal(2024);
+    calc_chn_cal(2022, mode, rule);
+    calc_chn_cal(2023, mode, rule);
+    calc_chn_cal(2024, mode, rule);
 
     // 1993 闰三月
-    calc_chn_cal(1992);
-    calc_chn_cal(1993);
-    calc_chn_cal(1994);
+    calc_chn_cal(1992, mode, rule);
+    calc_chn_cal(1993, mode, rule);
+    calc_chn_cal(1994, mode, rule);
 
     // 2020 闰四月
-    calc_chn_cal(2019);
-    calc_chn_cal(2020);
-    calc_chn_cal(2021);
+    calc_chn_cal(2019, mode, rule);
+    calc_chn_cal(2020, mode, rule);
+    calc_chn_cal(2021, mode, rule);
 
     // 2009 闰五月
-    calc_chn_cal(2008);
-    calc_chn_cal(2009);
-    calc_chn_cal(2010);
+    calc_chn_cal(2008, mode, rule);
+    calc_chn_cal(2009, mode, rule);
+    calc_chn_cal(2010, mode, rule);
 
     // 2017 闰六月
-    calc_chn_cal(2016);
-    calc_chn_cal(2017);
-    calc_chn_cal(2018);
+    calc_chn_cal(2016, mode, rule);
+    calc_chn_cal(2017, mode, rule);
+    calc_chn_cal(2018, mode, rule);
 
     // 2006 闰七月
-    calc_chn_cal(2005);
-    calc_chn_cal(2006);
-    calc_chn_cal(2007);
+    calc_chn_cal(2005, mode, rule);
+    calc_chn_cal(2006, mode, rule);
+    calc_chn_cal(2007, mode, rule);
 
     // 1995 闰八月
-    calc_chn_cal(1994);
-    calc_chn_cal(1995);
-    calc_chn_cal(1996);
+    calc_chn_cal(1994, mode, rule);
+    calc_chn_cal(1995, mode, rule);
+    calc_chn_cal(1996, mode, rule);
 
     // 2014 闰九月
-    calc_chn_cal(2013);
-    calc_chn_cal(2014);
-    calc_chn_cal(2015);
+    calc_chn_cal(2013, mode, rule);
+    calc_chn_cal(2014, mode, rule);
+    calc_chn_cal(2015, mode, rule);
 
     // 1984 闰十月
-    calc_chn_cal(1983);
-    calc_chn_cal(1984);
-    calc_chn_cal(1985);
+    calc_chn_cal(1983, mode, rule);
+    calc_chn_cal(1984, mode, rule);
+    calc_chn_cal(1985, mode, rule);
 
     // 2033 闰十一月
-    calc_chn_cal(2032);
-    calc_chn_cal(2033);
-    calc_chn_cal(2034);
+    calc_chn_cal(2032, mode, rule);
+    calc_chn_cal(2033, mode, rule);
+    calc_chn_cal(2034, mode, rule);
 
     // 测试数据3358年 闰十二月
-    calc_chn_cal(3357);
-    calc_chn_cal(3358);
-    calc_chn_cal(3359);
+    calc_chn_cal(3357, mode, rule);
+    calc_chn_cal(3358, mode, rule);
+    calc_chn_cal(3359, mode, rule);
+}
+
+// sin/cos内核的精度：按各周期项表在[first_year, last_year]内实际产生的相位逐项比较
+// 参照值为__float128的sinq/cosq（没有时为long double的libm），列出最大绝对误差
+static void print_trig_report(int first_year, int last_year) {
+    typedef astronomy::impl I;
+    constexpr int SAMPLES = 2000;
+
+    struct table_t {
+        const char *name;
+        bool cosine;  // VSOP87为a·cos，ELP2000与章动为a·sin
+        int kind;  // 0 VSOP87 b + c·t，t为儒略千年；1 ELP2000 四次多项式，t为儒略世纪；2 章动，同1
+        const void *terms;
+        std::size_t count;
+    };
+#define VSOP87_TABLE(t) { #t, true, 0, I::t, sizeof(I::t) / sizeof(*I::t) }
+#define ELP2000_TABLE(t) { #t, false, 1, I::t, sizeof(I::t) / sizeof(*I::t) }
+    const table_t tables[] = {
+        VSOP87_TABLE(E10), VSOP87_TABLE(E11), VSOP87_TABLE(E12), VSOP87_TABLE(E13), VSOP87_TABLE(E14), VSOP87_TABLE(E15),
+        VSOP87_TABLE(E20), VSOP87_TABLE(E21),
+        ELP2000_TABLE(M10), ELP2000_TABLE(M11), ELP2000_TABLE(M12), ELP2000_TABLE(M20), ELP2000_TABLE(M21),
+        { "NT", false, 2, I::NT, sizeof(I::NT) / sizeof(*I::NT) },
+    };
+#undef VSOP87_TABLE
+#undef ELP2000_TABLE
+
+    const astronomy::REAL jd0 = astronomy::make_julian_day(first_year, 1, 1, 0, 0, 0) - astronomy::JD2000;
+    const astronomy::REAL jd1 = astronomy::make_julian_day(last_year, 12, 31, 0, 0, 0) - astronomy::JD2000;
+    printf("years %d ~ %d, %d samples per table, max abs error against %s\n", first_year, last_year, SAMPLES,
+        ASTRONOMY_HAS_FLOAT128 ? "__float128" : "long double libm");
+    printf("%-5s %5s %12s | %-21s | %-32s\n", "", "", "", "       long double", "             double");
+    printf("%-5s %5s %12s | %10s %10s | %10s %10s %10s\n", "table", "terms", "max |phase|", "kernel", "libm", "kernel", "simd", "libm");
+
+    std::vector<double> xd, out;
+    for (const table_t &tb : tables) {
+        long double max_phase = 0, err_l = 0, err_lm = 0, err_d = 0, err_s = 0, err_dm = 0;
+        for (int k = 0; k < SAMPLES; ++k) {
+            const astronomy::REAL jd = jd0 + (jd1 - jd0) * k / (SAMPLES - 1);
+            xd.clear();
+            std::vector<long double> xl;
+            for (std::size_t i = 0; i < tb.count; ++i) {
+                long double x;
+                if (tb.kind == 0) {
+                    const auto &e = ((const astronomy::detail::vsop87_coefficient_t *)tb.terms)[i];
+                    x = e.b + e.c * (jd / 365250);
+                }
+                else if (tb.kind == 1) {
+                    const auto &e = ((const astronomy::detail::elp2000_coefficient_t *)tb.terms)[i];
+                    const long double t = jd / 36525;
+                    x = e.a0 + (e.a1 + (e.a2 + (e.a3 + e.a4 * t) * t) * t) * t;
+                }
+                else {
+                    const auto &e = ((const astronomy::detail::nutation_coefficient_t *)tb.terms)[i];
+                    const long double t = jd / 36525;
+                    x = e.a0 + (e.a1 + (e.a2 + (e.a3 + e.a4 * t) * t) * t) * t;
+                }
+                xl.push_back(x);
+                xd.push_back((double)x);
+                max_phase = std::max(max_phase, std::fabs(x));
+            }
+            out.resize(xd.size());
+            astronomy::detail::fast_trig_n(xd.data(), xd.size(), tb.cosine, out.data());
+
+            for (std::size_t i = 0; i < xl.size(); ++i) {
+                const long double x = xl[i];
+                const double d = xd[i];
+#if ASTRONOMY_HAS_FLOAT128
+                const long double ref_l = (long double)(tb.cosine ? cosq((__float128)x) : sinq((__float128)x));
+                const long double ref_d = (long double)(tb.cosine ? cosq((__float128)d) : sinq((__float128)d));
+#else
+                const long double ref_l = tb.cosine ? std::cos(x) : std::sin(x);
+                const long double ref_d = tb.cosine ? std::cos((long double)d) : std::sin((long double)d);
 #endif
+                const long double fl = tb.cosine ? astronomy::detail::fast_cos(x) : astronomy::detail::fast_sin(x);
+                const double fd = tb.cosine ? astronomy::detail::fast_cos(d) : astronomy::detail::fast_sin(d);
+                err_l = std::max(err_l, std::fabs(fl - ref_l));
+                err_lm = std::max(err_lm, std::fabs((tb.cosine ? std::cos(x) : std::sin(x)) - ref_l));
+                err_d = std::max(err_d, std::fabs(fd - ref_d));
+                err_s = std::max(err_s, std::fabs(out[i] - ref_d));
+                err_dm = std::max(err_dm, std::fabs((tb.cosine ? std::cos(d) : std::sin(d)) - ref_d));
+            }
+        }
+        printf("%-5s %5zu %12.1Lf | %10.2Le %10.2Le | %10.2Le %10.2Le %10.2Le\n", tb.name, tb.count, max_phase, err_l, err_lm, err_d, err_s, err_dm);
+    }
+}
 
-#if 0
+// 与历书对照：计算结果接近子夜的节气与朔
+static void print_almanac_samples(calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) {
     //         计算                历书
     // 1803-09-08 23:52:11.667 | 09 白露
     // 1805-08-23 23:51:55.314 | 24 处暑 七月大
@@ -626,89 +595,573 @@ int main() {
     // 1979-01-21 00:00:02.815 | 20 大寒
     // 2008-05-21 00:00:54.920 | 20 小满
 
-    calc_chn_cal(1803);  // 09-08 23:52:11.667 | 09 白露
-    calc_chn_cal(1804);  // 七月大 08-05
-    calc_chn_cal(1805);  // 08-23 23:51:55.314 | 24 处暑 七月大
-    calc_chn_cal(1807);  // 02-05 00:00:17.045 | 04 立春
-    calc_chn_cal(1808);  // 06-21 23:51:45.160 | 22 夏至
-    calc_chn_cal(1809);  // 11-22 23:44:42.817 | 23 小雪
-    calc_chn_cal(1812);  // 03-06 00:19:51.796 | 05 惊蛰
-    calc_chn_cal(1813);  // 04-30 23:56:19.686 | 01 四月小
-    calc_chn_cal(1814);  // 12-07 23:58:25.509 | 08 大雪
-    calc_chn_cal(1815);  // 清明 04-05
-    calc_chn_cal(1817);  // 10-08 23:40:19.648 | 09 寒露
+    calc_chn_cal(1803, mode, rule);  // 09-08 23:52:11.667 | 09 白露
+    calc_chn_cal(1804, mode, rule);  // 七月大 08-05
+    calc_chn_cal(1805, mode, rule);  // 08-23 23:51:55.314 | 24 处暑 七月大
+    calc_chn_cal(1807, mode, rule);  // 02-05 00:00:17.045 | 04 立春
+    calc_chn_cal(1808, mode, rule);  // 06-21 23:51:45.160 | 22 夏至
+    calc_chn_cal(1809, mode, rule);  // 11-22 23:44:42.817 | 23 小雪
+    calc_chn_cal(1812, mode, rule);  // 03-06 00:19:51.796 | 05 惊蛰
+    calc_chn_cal(1813, mode, rule);  // 04-30 23:56:19.686 | 01 四月小
+    calc_chn_cal(1814, mode, rule);  // 12-07 23:58:25.509 | 08 大雪
+    calc_chn_cal(1815, mode, rule);  // 清明 04-05
+    calc_chn_cal(1817, mode, rule);  // 10-08 23:40:19.648 | 09 寒露
                          // 10-10 23:47:39.041 | 11 九月小
-    calc_chn_cal(1818);  // 09-23 23:54:52.482 | 24 秋分
-    calc_chn_cal(1820);  // 02-20 00:06:22.697 | 19 雨水
+    calc_chn_cal(1818, mode, rule);  // 09-23 23:54:52.482 | 24 秋分
+    calc_chn_cal(1820, mode, rule);  // 02-20 00:06:22.697 | 19 雨水
                          // 12-05 23:47:16.656 | 06 十一月小
-    calc_chn_cal(1823);  // 05-10 23:55:25.652 | 11 四月小
-    calc_chn_cal(1824);  // 08-07 23:44:18.970 | 08 立秋
-    calc_chn_cal(1825);  // 11-07 23:51:41.744 | 08 立冬
-    calc_chn_cal(1826);  // 小满 05-21
-    calc_chn_cal(1829);  // 10-23 23:55:06.218 | 24 霜降
+    calc_chn_cal(1823, mode, rule);  // 05-10 23:55:25.652 | 11 四月小
+    calc_chn_cal(1824, mode, rule);  // 08-07 23:44:18.970 | 08 立秋
+    calc_chn_cal(1825, mode, rule);  // 11-07 23:51:41.744 | 08 立冬
+    calc_chn_cal(1826, mode, rule);  // 小满 05-21
+    calc_chn_cal(1829, mode, rule);  // 10-23 23:55:06.218 | 24 霜降
                          // 11-07 23:21:08.805 | 08 立冬
-    calc_chn_cal(1831);  // 三月大 04-12
-    calc_chn_cal(1836);  // 09-07 23:37:15.542 | 08 白露
-    calc_chn_cal(1839);  // 01-20 23:59:09.959 | 21 大寒
-    calc_chn_cal(1842);  // 01-12 00:01:08.204 | 11 十二月大
+    calc_chn_cal(1831, mode, rule);  // 三月大 04-12
+    calc_chn_cal(1836, mode, rule);  // 09-07 23:37:15.542 | 08 白露
+    calc_chn_cal(1839, mode, rule);  // 01-20 23:59:09.959 | 21 大寒
+    calc_chn_cal(1842, mode, rule);  // 01-12 00:01:08.204 | 11 十二月大
                          // 11-02 23:54:28.000 | 03 十月小
                          // 11-22 23:56:57.039 | 23 小雪
-    calc_chn_cal(1844);  // 06-05 23:35:02.385 | 06 芒种
-    calc_chn_cal(1846);  // 11-22 23:09:36.239 | 23 小雪
-    calc_chn_cal(1848);  // 12-21 23:45:21.945 | 22 冬至
-    calc_chn_cal(1849);  // 09-16 23:47:33.521 | 17 八月小
-    calc_chn_cal(1850);  // 10-08 23:23:59.024 | 09 寒露
-    calc_chn_cal(1851);  // 09-23 23:36:00.653 | 24 秋分
+    calc_chn_cal(1844, mode, rule);  // 06-05 23:35:02.385 | 06 芒种
+    calc_chn_cal(1846, mode, rule);  // 11-22 23:09:36.239 | 23 小雪
+    calc_chn_cal(1848, mode, rule);  // 12-21 23:45:21.945 | 22 冬至
+    calc_chn_cal(1849, mode, rule);  // 09-16 23:47:33.521 | 17 八月小
+    calc_chn_cal(1850, mode, rule);  // 10-08 23:23:59.024 | 09 寒露
+    calc_chn_cal(1851, mode, rule);  // 09-23 23:36:00.653 | 24 秋分
                          // 12-07 23:29:24.869 | 08 大雪
-    calc_chn_cal(1855);  // 谷雨 04-20
-    calc_chn_cal(1856);  // 11-27 23:46:58.303 | 28 十一月小
-    calc_chn_cal(1861);  // 11-02 23:50:25.224 | 03 十月小
-    calc_chn_cal(1862);  // 10-23 23:30:45.572 | 24 霜降
+    calc_chn_cal(1855, mode, rule);  // 谷雨 04-20
+    calc_chn_cal(1856, mode, rule);  // 11-27 23:46:58.303 | 28 十一月小
+    calc_chn_cal(1861, mode, rule);  // 11-02 23:50:25.224 | 03 十月小
+    calc_chn_cal(1862, mode, rule);  // 10-23 23:30:45.572 | 24 霜降
                          // 11-07 23:09:11.430 | 08 立冬
-    calc_chn_cal(1863);  // 腊月大 01-19
-    calc_chn_cal(1864);  // 07-22 23:36:01.878 | 23 大暑
-    calc_chn_cal(1865);  // 09-07 23:52:34.285 | 08 白露
-    calc_chn_cal(1866);  // 10-23 22:59:36.710 | 24 霜降
-    calc_chn_cal(1867);  // 07-07 23:36:24.529 | 08 小暑
+    calc_chn_cal(1863, mode, rule);  // 腊月大 01-19
+    calc_chn_cal(1864, mode, rule);  // 07-22 23:36:01.878 | 23 大暑
+    calc_chn_cal(1865, mode, rule);  // 09-07 23:52:34.285 | 08 白露
+    calc_chn_cal(1866, mode, rule);  // 10-23 22:59:36.710 | 24 霜降
+    calc_chn_cal(1867, mode, rule);  // 07-07 23:36:24.529 | 08 小暑
                          // 08-23 23:38:56.617 | 24 处暑
-    calc_chn_cal(1869);  // 05-11 23:52:26.505 | 12 四月小
-    calc_chn_cal(1878);  // 05-05 23:59:55.681 | 06 立夏
-    calc_chn_cal(1879);  // 01-05 23:36:40.508 | 06 小寒
+    calc_chn_cal(1869, mode, rule);  // 05-11 23:52:26.505 | 12 四月小
+    calc_chn_cal(1878, mode, rule);  // 05-05 23:59:55.681 | 06 立夏
+    calc_chn_cal(1879, mode, rule);  // 01-05 23:36:40.508 | 06 小寒
                          // 10-08 23:50:13.701 | 09 寒露
                          // 11-22 23:15:47.989 | 23 小雪
-    calc_chn_cal(1880);  // 09-22 23:52:20.616 | 23 秋分
+    calc_chn_cal(1880, mode, rule);  // 09-22 23:52:20.616 | 23 秋分
                          // 11-02 23:41:05.343 | 03 十月小
-    calc_chn_cal(1881);  // 12-21 23:46:13.515 | 22 冬至
-    calc_chn_cal(1883);  // 10-08 23:03:51.174 | 09 寒露
-    calc_chn_cal(1884);  // 09-22 23:06:57.334 | 23 秋分
+    calc_chn_cal(1881, mode, rule);  // 12-21 23:46:13.515 | 22 冬至
+    calc_chn_cal(1883, mode, rule);  // 10-08 23:03:51.174 | 09 寒露
+    calc_chn_cal(1884, mode, rule);  // 09-22 23:06:57.334 | 23 秋分
                          // 12-06 23:35:51.495 | 07 大雪
-    calc_chn_cal(1886);  // 08-07 23:29:50.334 | 08 立秋
-    calc_chn_cal(1887);  // 03-24 23:54:58.213 | 25 三月小
-    calc_chn_cal(1893);  // 07-22 23:51:14.096 | 23 大暑
-    calc_chn_cal(1895);  // 10-23 23:32:12.762 | 24 霜降
+    calc_chn_cal(1886, mode, rule);  // 08-07 23:29:50.334 | 08 立秋
+    calc_chn_cal(1887, mode, rule);  // 03-24 23:54:58.213 | 25 三月小
+    calc_chn_cal(1893, mode, rule);  // 07-22 23:51:14.096 | 23 大暑
+    calc_chn_cal(1895, mode, rule);  // 10-23 23:32:12.762 | 24 霜降
                          // 11-07 23:22:05.606 | 08 立冬
-    calc_chn_cal(1896);  // 正月大 02-13
+    calc_chn_cal(1896, mode, rule);  // 正月大 02-13
                          // 07-06 23:52:05.616 | 07 小暑
                          // 08-22 23:50:36.246 | 23 处暑
-    calc_chn_cal(1898);  // 09-07 23:24:58.401 | 08 白露
-    calc_chn_cal(1899);  // 06-21 23:31:13.699 | 22 夏至
+    calc_chn_cal(1898, mode, rule);  // 09-07 23:24:58.401 | 08 白露
+    calc_chn_cal(1899, mode, rule);  // 06-21 23:31:13.699 | 22 夏至
                          // 10-23 22:52:11.480 | 24 霜降
-    calc_chn_cal(1906);  // 04-23 23:51:31.408 | 24 四月小
-    calc_chn_cal(1909);  // 01-20 23:56:35.795 | 21 大寒
-    calc_chn_cal(1911);  // 05-06 23:45:58.481 | 07 立夏
-    calc_chn_cal(1912);  // 01-06 23:53:06.441 | 07 小寒
+    calc_chn_cal(1906, mode, rule);  // 04-23 23:51:31.408 | 24 四月小
+    calc_chn_cal(1909, mode, rule);  // 01-20 23:56:35.795 | 21 大寒
+    calc_chn_cal(1911, mode, rule);  // 05-06 23:45:58.481 | 07 立夏
+    calc_chn_cal(1912, mode, rule);  // 01-06 23:53:06.441 | 07 小寒
                          // 10-08 23:52:18.898 | 09 寒露
                          // 11-22 23:33:43.341 | 23 小雪
-    calc_chn_cal(1913);  // 09-23 23:38:19.512 | 24 秋分
-    calc_chn_cal(1914);  // 十月大 11-17
-    calc_chn_cal(1916);  // 正月大 02-03
-    calc_chn_cal(1917);  // 大雪 12-07
-    calc_chn_cal(1920);  // 十月大 11-10
-    calc_chn_cal(1927);  // 白露 09-08
-    calc_chn_cal(1928);  // 夏至 06-21
-    calc_chn_cal(1979);  // 01-21 00:00:02.815 | 20 大寒
-    calc_chn_cal(2008);  // 05-21 00:00:54.920 | 20 小满
-#endif
+    calc_chn_cal(1913, mode, rule);  // 09-23 23:38:19.512 | 24 秋分
+    calc_chn_cal(1914, mode, rule);  // 十月大 11-17
+    calc_chn_cal(1916, mode, rule);  // 正月大 02-03
+    calc_chn_cal(1917, mode, rule);  // 大雪 12-07
+    calc_chn_cal(1920, mode, rule);  // 十月大 11-10
+    calc_chn_cal(1927, mode, rule);  // 白露 09-08
+    calc_chn_cal(1928, mode, rule);  // 夏至 06-21
+    calc_chn_cal(1979, mode, rule);  // 01-21 00:00:02.815 | 20 大寒
+    calc_chn_cal(2008, mode, rule);  // 05-21 00:00:54.920 | 20 小满
+}
+
+// 缓冲输出，攒满capacity字节才写一次
+class buffered_writer {
+public:
+    explicit buffered_writer(FILE *fp, std::size_t capacity = 1 << 20) : _fp(fp), _capacity(capacity) {
+        _buffer.reserve(capacity + 4096);
+    }
+
+    ~buffered_writer() {
+        flush();
+    }
+
+    void write(const std::string &s) {
+        _buffer += s;
+        if (_buffer.size() >= _capacity) flush();
+    }
+
+    void flush() {
+        if (!_buffer.empty()) fwrite(_buffer.data(), 1, _buffer.size(), _fp);
+        _buffer.clear();
+        fflush(_fp);
+    }
+
+private:
+    FILE *_fp;
+    std::size_t _capacity;
+    std::string _buffer;
+};
+
+// 读一行，不含换行符，EOF时返回false
+static bool read_line(FILE *fp, std::string &line) {
+    char buf[4096];
+    line.clear();
+    while (fgets(buf, sizeof(buf), fp) != nullptr) {
+        line += buf;
+        if (line.back() == '\n') {
+            line.pop_back();
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+// 从stdin逐行读入查询，每batch_size行为一批，批内按连续的块分给各线程，结果按输入顺序写到stdout
+// 每个线程有自己的计算上下文，同一块内的相邻查询多落在同一农历年
+static void run_batch(const calendar::query::options_t &opt, std::size_t batch_size, int threads) {
+    std::vector<calendar::calendar_context> contexts(threads, calendar::calendar_context(opt.mode, opt.rule));
+    std::vector<std::string> lines(batch_size);
+    std::vector<std::string> results(threads);
+    buffered_writer writer(stdout);
+
+    bool eof = false;
+    while (!eof) {
+        std::size_t n = 0;
+        while (n < batch_size && !(eof = !read_line(stdin, lines[n]))) ++n;
+        if (n == 0) break;
+
+        const int t_count = (int)std::min<std::size_t>(threads, (n + 255) / 256);
+        auto work = [&](int t) {
+            std::string &out = results[t];
+            out.clear();
+            for (std::size_t i = n * t / t_count, e = n * (t + 1) / t_count; i < e; ++i) {
+                calendar::query::execute(contexts[t], lines[i].c_str(), out);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < t_count; ++t) workers.emplace_back(work, t);
+        work(0);
+        for (auto &w : workers) w.join();
+
+        for (int t = 0; t < t_count; ++t) writer.write(results[t]);
+    }
+}
+
+static void print_usage() {
+    printf(
+        "usage: calendar [options] <command> [args]\n"
+        "commands:\n"
+        "  year <from> [to]          lunar years\n"
+        "  terms <year>              solar terms of a Gregorian year\n"
+        "  term-days <from> <to>     day of month of each solar term, one line per year\n"
+        "  moons <year>              new moons of a Gregorian year\n"
+        "  phases <year>             moon phases of a Gregorian year\n"
+        "  events <Y-M-D> <count>    solar terms and moon phases from a date, negative count goes backward\n"
+        "  days <Y-M-D> <count>      day by day listing\n"
+        "  g2l <Y-M-D>...            Gregorian to lunar\n"
+        "  l2g <Y-M-D>...            lunar to Gregorian, leap month written as L<month>, e.g. 2023-L02-01\n"
+        "  pillars <Y-M-DTHH:MM[:SS]>...  four pillars\n"
+        "  festivals <from> [to] [name]  festivals, 三伏 and 数九; name as in batch\n"
+        "  ics <from> <to> [path]    iCalendar export of lunar years, to stdout without path\n"
+        "  generate <from> <to> <path>   lunar year table; with --shard i/N writes slice i to <path>.i-of-N\n"
+        "  regen <path> <from> <to>  generate a lunar year table, later recompute only years whose ΔT segments changed\n"
+        "  merge <path> <parts>...   validate shards and merge them into one table\n"
+        "  pack <from> <to>          pack lunar years into 16 bytes each and check that every year unpacks to the computed dates\n"
+        "  compare <year>            new moons in China, Vietnam and Korea\n"
+        "  db <path> <from> <to>     lunar years from an event database, generated if missing\n"
+        "  samples [almanac]         leap month samples, or comparison with historical almanacs\n"
+        "  eclipses <from> <to>      eclipse candidates: UT, 日/月, moon latitude and distance to the node (degrees)\n"
+        "  sun <lon> <lat> <Y-M-D> <count>  sunrise, apparent noon, sunset and equation of time (minutes);\n"
+        "                            east longitude and north latitude in degrees, times in --tz\n"
+        "  trig [from to]            accuracy of the series sin/cos kernels against libm (default -1000 3000)\n"
+        "  batch                     read queries from stdin, one per line, years -4000 to 5999:\n"
+        "                              g2l Y-M-D | l2g Y-M-D | year Y | terms Y | moons Y | events Y-M-D N | Y-M-D\n"
+        "                              festival <name> <from> <to>, name: spring lantern qingming dragon-boat qixi\n"
+        "                              mid-autumn double-ninth winter-solstice chufu zhongfu mofu sanfu-end shujiu shujiu-end\n"
+        "  serve <address>           answer the same queries on unix:<path> or tcp:<port> (localhost)\n"
+        "  load <address> <connections> <requests> [from to]  load generator, reports latency percentiles\n"
+        "options:\n"
+        "  --mode full|adaptive|certified   precision tier (default full; adaptive for batch)\n"
+        "  --tz china|vietnam|korea|<hours>|lmt:<longitude>   time zone (default china)\n"
+        "  --batch-size <n>                 lines per batch (default 65536)\n"
+        "  --threads <n>                    worker threads for batch, ics, eclipses and year solving (default: hardware concurrency)\n"
+        "  --shard <i>/<N>                  generate only slice i (1-based) of N, plus one overlap year each side\n"
+        "  --true-solar <longitude>         for pillars: day and hour pillars by true solar time at this east longitude\n"
+        "  --cache <path>                   for year: reuse lunar years stored in <path> and append newly computed ones\n"
+        "  --stats                          print per-stage throughput of the year pipeline to stderr\n"
+        "  --kinds days,months,terms,festivals   events for ics (default months,terms,festivals)\n");
+}
+
+static bool parse_mode(const char *s, calendar::calc_mode_t &mode) {
+    if (strcmp(s, "full") == 0) mode = calendar::CALC_FULL;
+    else if (strcmp(s, "adaptive") == 0) mode = calendar::CALC_ADAPTIVE;
+    else if (strcmp(s, "certified") == 0) mode = calendar::CALC_CERTIFIED;
+    else return false;
+    return true;
+}
+
+static bool parse_timezone(const char *s, calendar::timezone_rule_t &rule) {
+    char *end;
+    if (strcmp(s, "china") == 0) rule = calendar::TIMEZONE_RULE_CHINA;
+    else if (strcmp(s, "vietnam") == 0) rule = calendar::TIMEZONE_RULE_VIETNAM;
+    else if (strcmp(s, "korea") == 0) rule = calendar::TIMEZONE_RULE_KOREA;
+    else if (strncmp(s, "lmt:", 4) == 0) {
+        const double lon = strtod(s + 4, &end);
+        if (end == s + 4 || *end != '\0') return false;
+        rule = calendar::timezone_from_longitude(s, lon);
+    }
+    else {
+        const double hours = strtod(s, &end);
+        if (end == s || *end != '\0') return false;
+        rule = calendar::timezone_fixed(s, hours);
+    }
+    return true;
+}
+
+// 东经度数，西经为负
+static bool parse_longitude(const char *s, double &longitude) {
+    char *end;
+    longitude = strtod(s, &end);
+    return end != s && *end == '\0' && longitude >= -180 && longitude <= 180;
+}
+
+// 逗号分隔的days、months、terms、festivals
+static bool parse_ics_kinds(const char *s, int &kinds) {
+    static const char *names[] = { "days", "months", "terms", "festivals" };
+    kinds = 0;
+    while (*s != '\0') {
+        const char *e = strchr(s, ',');
+        const std::size_t n = e != nullptr ? (std::size_t)(e - s) : strlen(s);
+        int k = 0;
+        while (k < 4 && (strlen(names[k]) != n || strncmp(s, names[k], n) != 0)) ++k;
+        if (k == 4) return false;
+        kinds |= 1 << k;
+        s += n + (e != nullptr);
+    }
+    return kinds != 0;
+}
+
+static bool parse_date_arg(const char *s, int &y, int &m, int &d) {
+    bool leap;
+    return calendar::query::parse_date(s, y, m, leap, d, false) && *s == '\0' && calendar::query::valid_civil(y, m, d);
+}
+
+// Y-M-DTHH:MM[:SS]
+static bool parse_daytime_arg(const char *s, astronomy::daytime_t &dt) {
+    bool leap;
+    if (!calendar::query::parse_date(s, dt.year, dt.month, leap, dt.day, false) || !calendar::query::valid_civil(dt.year, dt.month, dt.day)) return false;
+    dt.hour = dt.minute = 0;
+    dt.second = 0;
+    if (*s == '\0') return true;
+    if (*s != 'T' && *s != ' ') return false;
+    ++s;
+    if (!calendar::query::parse_int(s, dt.hour) || *s++ != ':' || !calendar::query::parse_int(s, dt.minute)) return false;
+    if (*s == ':') {
+        char *end;
+        dt.second = strtod(s + 1, &end);
+        s = end;
+    }
+    return *s == '\0';
+}
+
+// 各年的节日与三伏、数九，festival为-1时显示全部
+static void print_festivals(int y0, int y1, int festival, calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) {
+    calendar::calendar_context ctx(mode, rule);
+    calendar::calc_festivals_range(ctx, y0, y1, [festival](const calendar::festival_year_t &fy) {
+        printf("%d", fy.year);
+        for (int i = 0; i < calendar::FESTIVAL_COUNT; ++i) {
+            if (festival >= 0 && i != festival) continue;
+            if (fy.days[i] == INT_MIN) {
+                printf(" %s=?", calendar::festival_names[i]);
+                continue;
+            }
+            int y, m, d;
+            astronomy::civil_from_day_number(fy.days[i], &y, &m, &d);
+            printf(" %s=", calendar::festival_names[i]);
+            if (y != fy.year) printf("%d-", y);
+            printf("%.2d-%.2d ", m, d);
+            print_daytime_cstb(fy.days[i]);
+        }
+        printf("\n");
+    });
+}
+
+// 日出、视正午、日落，时间为rule所指的当地时间
+static void print_sun_days(double longitude, double latitude, int year, int month, int day, int count, const calendar::timezone_rule_t &rule) {
+    if (count <= 0) return;
+    const calendar::sun::location_t loc = { longitude, latitude };
+    const astronomy::day_number_t first = astronomy::day_number_from_civil(year, month, day);
+    std::vector<calendar::sun::sun_day_t> out(count);
+    calendar::sun::calc_sun_days(&loc, 1, first, first + count - 1, rule, out.data());
+
+    auto print_time = [](astronomy::REAL jd) {
+        if (std::isnan((double)jd)) {
+            printf(" --:--:--");
+            return;
+        }
+        astronomy::daytime_t dt;
+        astronomy::daytime_from_julian_day(jd + 0.5 / 86400, &dt);
+        printf(" %.2d:%.2d:%.2d", dt.hour, dt.minute, (int)dt.second);
+    };
+    for (const auto &r : out) {
+        int y, m, d;
+        astronomy::civil_from_day_number(r.day, &y, &m, &d);
+        printf("%d-%.2d-%.2d", y, m, d);
+        print_time(r.rise);
+        print_time(r.noon);
+        print_time(r.set);
+        printf(" %+6.2f%s\n", r.equation_of_time, r.status == calendar::sun::SUN_ALWAYS_UP ? " 極晝" : r.status == calendar::sun::SUN_ALWAYS_DOWN ? " 極夜" : "");
+    }
+}
+
+// 食季候选，时间为世界时，日期为历史纪年（1582年10月15日之前为儒略历）
+static void print_eclipse_candidates(int first_year, int last_year, int threads) {
+    const auto candidates = calendar::eclipse::screen_years(first_year, last_year, threads);
+    std::size_t solar = 0;
+    for (const auto &c : candidates) {
+        astronomy::daytime_t dt;
+        astronomy::daytime_from_julian_day(c.jd - astronomy::calc_delta_t(c.jd), &dt);
+        printf("%d-%.2d-%.2d %.2d:%.2d %s %+.4f %+6.2f\n", dt.year, dt.month, dt.day, dt.hour, dt.minute,
+            c.solar ? "日" : "月", c.latitude, c.node_distance);
+        solar += c.solar;
+    }
+    printf("%zu candidates, %zu solar, %zu lunar\n", candidates.size(), solar, candidates.size() - solar);
+}
+
+// 增量重算年表，列出变了的朔日、节气
+static int regenerate_table(const char *path, int first_year, int last_year, calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) {
+    calendar::incremental::result_t result;
+    std::string error;
+    if (!calendar::incremental::regenerate(path, first_year, last_year, mode, rule, result, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    for (const auto &c : result.changes) {
+        printf("%d\t%s %s\t%s -> %s\n", c.year, c.key[0] == 'm' ? "month" : "term", c.key.c_str() + 1,
+            c.before.empty() ? "(none)" : c.before.c_str(), c.after.empty() ? "(none)" : c.after.c_str());
+    }
+    printf("%s: recomputed %d of %d years%s, %d years changed\n", path, result.recomputed, last_year - first_year + 1,
+        result.full ? " (full)" : "", result.changed_years);
+    return 0;
+}
+
+// 两个农历年的日期（各月初一、月序、大小，各节气的日期与序号）是否相同，不比较时刻
+static bool same_lunar_dates(const calendar::lunar_year_t &a, const calendar::lunar_year_t &b) {
+    if (a.month_count != b.month_count || a.leap_month != b.leap_month || a.end_day != b.end_day || a.term_count != b.term_count) return false;
+    for (int i = 0; i < a.month_count; ++i) {
+        const calendar::lunar_month_t &x = a.months[i], &y = b.months[i];
+        if (x.first_day != y.first_day || x.month != y.month || x.leap != y.leap || x.major != y.major) return false;
+    }
+    for (int i = 0; i < a.term_count; ++i) {
+        if (a.terms[i].day != b.terms[i].day || a.terms[i].index != b.terms[i].index) return false;
+    }
+    return true;
+}
+
+// 压缩农历年表，逐年解开后与直接计算的结果比较，有不同的年份时返回1
+static int check_packed_years(int y0, int y1, calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) {
+    const calendar::packed_year_table table(y0, y1, mode, rule);
+    int unpacked = 0, mismatched = 0;
+    for (int y = y0; y <= y1; ++y) {
+        calendar::lunar_year_t expected, actual;
+        calendar::calc_lunar_year(y, expected, mode, rule);
+        table.lunar_year(y, actual);
+        if (!table.packed(y)) ++unpacked;
+        if (!same_lunar_dates(expected, actual)) {
+            printf("%d mismatch\n", y);
+            ++mismatched;
+        }
+    }
+    printf("%d years, %zu bytes, %d not packed, %d mismatched\n", y1 - y0 + 1, table.size_in_bytes(), unpacked, mismatched);
+    return mismatched != 0;
+}
+
+int main(int argc, char *argv[]) {
+    calendar::query::options_t opt;
+    bool mode_given = false;
+    std::size_t batch_size = 65536;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int ics_kinds = calendar::ics::options_t().kinds;
+    int shard_index = 0, shard_count = 0;
+    const char *cache_path = nullptr;
+    double solar_longitude = 0;
+    bool solar_given = false;
+    bool stats = false;
+
+    std::vector<const char *> args;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        if (a[0] != '-' || a[1] != '-') {
+            args.push_back(a);
+            continue;
+        }
+
+        if (strcmp(a, "--stats") == 0) {
+            stats = true;
+            continue;
+        }
+
+        const char *v = i + 1 < argc ? argv[++i] : nullptr;
+        bool ok;
+        if (v == nullptr) ok = false;
+        else if (strcmp(a, "--mode") == 0) ok = mode_given = parse_mode(v, opt.mode);
+        else if (strcmp(a, "--tz") == 0) ok = parse_timezone(v, opt.rule);
+        else if (strcmp(a, "--batch-size") == 0) ok = (batch_size = strtoul(v, nullptr, 10)) > 0;
+        else if (strcmp(a, "--threads") == 0) ok = (threads = atoi(v)) > 0;
+        else if (strcmp(a, "--kinds") == 0) ok = parse_ics_kinds(v, ics_kinds);
+        else if (strcmp(a, "--cache") == 0) ok = (cache_path = v) != nullptr;
+        else if (strcmp(a, "--true-solar") == 0) ok = solar_given = parse_longitude(v, solar_longitude);
+        else if (strcmp(a, "--shard") == 0) ok = sscanf(v, "%d/%d", &shard_index, &shard_count) == 2 && shard_index >= 1 && shard_index <= shard_count;
+        else ok = false;
+        if (!ok) {
+            print_usage();
+            return 1;
+        }
+    }
+    if (args.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    // 批量查询默认用自适应档，交互命令默认用完整档
+    const std::string cmd = args[0];
+    const std::size_t nargs = args.size() - 1;
+    const calendar::calc_mode_t mode = mode_given ? opt.mode : calendar::CALC_FULL;
+    const calendar::timezone_rule_t &rule = opt.rule;
+    int y, m, d;
+
+    if (cmd == "batch" && nargs == 0) {
+        if (!mode_given) opt.mode = calendar::CALC_ADAPTIVE;
+        run_batch(opt, batch_size, threads);
+    }
+    else if (cmd == "serve" && nargs == 1) {
+        if (!mode_given) opt.mode = calendar::CALC_ADAPTIVE;
+        if (!calendar::server::run(args[1], opt)) {
+            printf("cannot listen on %s\n", args[1]);
+            return 1;
+        }
+    }
+    else if (cmd == "load" && (nargs == 3 || nargs == 5)) {
+        calendar::server::load_report_t r;
+        const int y0 = nargs == 5 ? atoi(args[4]) : 1900, y1 = nargs == 5 ? atoi(args[5]) : 2100;
+        if (!calendar::server::run_load(args[1], atoi(args[2]), strtoul(args[3], nullptr, 10), y0, y1, r)) {
+            printf("cannot connect to %s\n", args[1]);
+            return 1;
+        }
+        printf("requests %zu, errors %zu, %.3f s, %.0f req/s\n", r.requests, r.errors, r.seconds, r.requests / r.seconds);
+        printf("latency p50 %.1f us, p99 %.1f us, max %.1f us\n", r.p50, r.p99, r.max);
+    }
+    else if (cmd == "year" && (nargs == 1 || nargs == 2)) {
+        const int y0 = atoi(args[1]), y1 = nargs == 2 ? atoi(args[2]) : y0;
+        print_chn_cal_range(y0, y1, mode, rule, threads, stats, cache_path);
+    }
+    else if (cmd == "terms" && nargs == 1) {
+        calc_solar_term_for_year_full(atoi(args[1]), rule);
+    }
+    else if (cmd == "term-days" && nargs == 2) {
+        for (y = atoi(args[1]); y <= atoi(args[2]); ++y) calc_solar_term_for_year(y, rule);
+    }
+    else if (cmd == "moons" && nargs == 1) {
+        calc_new_moon_for_year_full(atoi(args[1]), rule);
+    }
+    else if (cmd == "phases" && nargs == 1) {
+        calc_moon_phase_for_year_full(atoi(args[1]), rule);
+    }
+    else if (cmd == "events" && nargs == 2 && parse_date_arg(args[1], y, m, d)) {
+        print_events(y, m, d, atoi(args[2]), mode, rule);
+    }
+    else if (cmd == "days" && nargs == 2 && parse_date_arg(args[1], y, m, d)) {
+        print_days(y, m, d, atoi(args[2]), mode, rule);
+    }
+    else if ((cmd == "g2l" || cmd == "l2g") && nargs >= 1) {
+        calendar::calendar_context ctx(mode, rule);
+        std::string out;
+        for (std::size_t i = 1; i <= nargs; ++i) {
+            calendar::query::execute(ctx, (cmd + " " + args[i]).c_str(), out);
+        }
+        fputs(out.c_str(), stdout);
+    }
+    else if (cmd == "pillars" && nargs >= 1) {
+        std::vector<astronomy::daytime_t> dts(nargs);
+        for (std::size_t i = 0; i < nargs; ++i) {
+            if (!parse_daytime_arg(args[i + 1], dts[i])) {
+                print_usage();
+                return 1;
+            }
+        }
+        print_four_pillars(dts.data(), (int)nargs, rule, solar_given ? &solar_longitude : nullptr);
+    }
+    else if (cmd == "festivals" && nargs >= 1 && nargs <= 3) {
+        const int y0 = atoi(args[1]), y1 = nargs >= 2 ? atoi(args[2]) : y0;
+        const int festival = nargs == 3 ? calendar::find_festival(args[3]) : -1;
+        if (nargs == 3 && festival < 0) {
+            print_usage();
+            return 1;
+        }
+        print_festivals(y0, y1, festival, mode_given ? opt.mode : calendar::CALC_ADAPTIVE, rule);
+    }
+    else if (cmd == "ics" && (nargs == 2 || nargs == 3)) {
+        calendar::ics::options_t io;
+        io.kinds = ics_kinds;
+        io.mode = mode_given ? opt.mode : calendar::CALC_ADAPTIVE;
+        io.rule = rule;
+        io.threads = threads;
+        if (!calendar::ics::export_file(nargs == 3 ? args[3] : nullptr, atoi(args[1]), atoi(args[2]), io)) {
+            fprintf(stderr, "export failed or years outside 0001-9999\n");
+            return 1;
+        }
+    }
+    else if (cmd == "generate" && nargs == 3) {
+        if (!calendar::shard::generate(args[3], atoi(args[1]), atoi(args[2]), mode, rule, shard_index, shard_count)) {
+            fprintf(stderr, "cannot generate %s\n", args[3]);
+            return 1;
+        }
+    }
+    else if (cmd == "regen" && nargs == 3) {
+        return regenerate_table(args[1], atoi(args[2]), atoi(args[3]), mode, rule);
+    }
+    else if (cmd == "pack" && nargs == 2) {
+        return check_packed_years(atoi(args[1]), atoi(args[2]), mode_given ? opt.mode : calendar::CALC_ADAPTIVE, rule);
+    }
+    else if (cmd == "merge" && nargs >= 2) {
+        std::string error;
+        if (!calendar::shard::merge(std::vector<std::string>(args.begin() + 2, args.end()), args[1], error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    else if (cmd == "compare" && nargs == 1) {
+        compare_timezones(atoi(args[1]), mode_given ? opt.mode : calendar::CALC_ADAPTIVE);
+    }
+    else if (cmd == "db" && nargs == 3) {
+        return print_lunar_years_from_db(args[1], atoi(args[2]), atoi(args[3]), mode, rule);
+    }
+    else if (cmd == "samples" && nargs == 0) {
+        print_leap_month_samples(mode, rule);
+    }
+    else if (cmd == "samples" && nargs == 1 && strcmp(args[1], "almanac") == 0) {
+        print_almanac_samples(mode, rule);
+    }
+    else if (cmd == "eclipses" && nargs == 2) {
+        print_eclipse_candidates(atoi(args[1]), atoi(args[2]), threads);
+    }
+    else if (cmd == "sun" && nargs == 4 && parse_date_arg(args[3], y, m, d)) {
+        print_sun_days(atof(args[1]), atof(args[2]), y, m, d, atoi(args[4]), rule);
+    }
+    else if (cmd == "trig" && (nargs == 0 || nargs == 2)) {
+        print_trig_report(nargs == 2 ? atoi(args[1]) : -1000, nargs == 2 ? atoi(args[2]) : 3000);
+    }
+    else {
+        print_usage();
+        return 1;
+    }
 
     return 0;
 }
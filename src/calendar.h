@@ -0,0 +1,1186 @@
+﻿#ifndef _CALENDAR_H_
+#define _CALENDAR_H_
+
+#include "astronomy.h"
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+namespace calendar {
+    static astronomy::REAL estimate_solar_term(int year, int angle) {
+        int month = (angle + 105) / 30;
+        if (month > 12) month -= 12;
+        if (angle % 30 == 0) {
+            return astronomy::make_julian_day(year, month, month < 8 ? 20 : 22, 0, 0, 0.0);
+        }
+        else {
+            return astronomy::make_julian_day(year, month, month < 8 ? 4 : 7, 0, 0, 0.0);
+        }
+    }
+
+    // 把角度差归到[-180, 180)，目标角附近的角度差不会因跨过0度而跳变
+    template <class T>
+    static T wrap_degrees_180(T d) {
+        while (d < -180) d += 360;
+        while (d >= 180) d -= 360;
+        return d;
+    }
+
+    // 各事件求解的收敛阈值（秒），为真实解与返回值之差的上界
+    // 全精度档取1毫秒，低精度档的级数本身有数秒误差，取0.1秒；证明档另由各级精度自定
+    static constexpr double EVENT_TOLERANCE_SECONDS = 0.001;
+    static constexpr double EVENT_LITE_TOLERANCE_SECONDS = 0.1;
+    static constexpr int EVENT_MAX_ITERATIONS = 32;
+
+    // 太阳视黄经每日变化0.95~1.05度，月日黄经差每日变化10~15.5度
+    // 下界用于把角度误差换算成时间误差，上下界一起用于由初值处的角度差框定真实解
+    static constexpr double SUN_MIN_DEGREES_PER_DAY = 0.95;
+    static constexpr double SUN_MAX_DEGREES_PER_DAY = 1.05;
+    static constexpr double ELONGATION_MIN_DEGREES_PER_DAY = 10.0;
+    static constexpr double ELONGATION_MAX_DEGREES_PER_DAY = 15.5;
+
+    template <class T, class V>
+    struct event_solution_t {
+        T jd;
+        astronomy::bounded_t<V> offset;  // jd处的角度差（度）及其计算误差
+        int iterations;  // 迭代次数，每次求值目标函数三次
+        bool converged;  // 在迭代上限内达到了收敛阈值
+    };
+
+    // 天文事件的统一求解：求f(jd) = 0，f返回bounded_t形式的角度差（度），已归一化到[-180, 180)
+    // 要求真实解在[lo, hi]内，且f在其中连续递增（太阳黄经、月日黄经差都是如此）
+    // 牛顿迭代，导数用步长step的中心差分；每步按f的符号收缩括号，牛顿步落到括号外时改取中点，不会发散
+    // 两次迭代之差不超过tolerance_seconds时停止，最多max_iterations次
+    template <class T, class F, class V = decltype(std::declval<F &>()(T()).value)>
+    static event_solution_t<T, V> solve_event(F &&f, T jd, T lo, T hi, double tolerance_seconds, T step, int max_iterations = EVENT_MAX_ITERATIONS) {
+        typedef astronomy::real_traits<T> R;
+        const T tolerance = (T)(tolerance_seconds / 86400);
+
+        event_solution_t<T, V> s;
+        T JD1 = jd;
+        for (s.iterations = 1;; ++s.iterations) {
+            s.jd = JD1;
+            s.offset = f(s.jd);
+            if (s.offset.value < 0) lo = s.jd;
+            else hi = s.jd;
+
+            const T Dp = (T)wrap_degrees_180(f(s.jd + step).value - f(s.jd - step).value) / (step * 2);
+            JD1 = s.jd - (T)s.offset.value / Dp;
+            if (!(JD1 >= lo && JD1 <= hi)) JD1 = (lo + hi) / 2;
+            s.converged = R::abs(JD1 - s.jd) <= tolerance;
+            if (s.converged || s.iterations >= max_iterations) break;
+        }
+        return s;
+    }
+
+    // 由初值jd处的角度差d框定真实解：解在jd - d / rate_min与jd - d / rate_max之间，从按平均速率外推的点开始迭代
+    // 初值须离目标角最近的那次事件不到半个周期，此时d不会跳变
+    template <class F>
+    static auto solve_event_near(F &&f, astronomy::REAL jd, double rate_min, double rate_max, double tolerance_seconds, astronomy::REAL step)
+        -> decltype(solve_event<astronomy::REAL>(f, jd, jd, jd, tolerance_seconds, step)) {
+        const astronomy::REAL d = f(jd).value;
+        const astronomy::REAL a = jd - d / rate_min, b = jd - d / rate_max, margin = 0.01;
+        return solve_event<astronomy::REAL>(f, jd - d * 2 / (rate_min + rate_max), std::min(a, b) - margin, std::max(a, b) + margin, tolerance_seconds, step);
+    }
+
+    // 全精度档的目标函数，没有误差界
+    static astronomy::bounded_t<astronomy::REAL> sun_longitude_offset(astronomy::REAL jd, int angle) {
+        return { wrap_degrees_180(astronomy::get_sun_ecliptic_longitude(jd) - angle), 0 };
+    }
+
+    // 太阳视黄经为angle的时刻，jd为初值
+    static astronomy::REAL calc_solar_term_nearby(astronomy::REAL jd, int angle) {
+        return solve_event_near([angle](astronomy::REAL t) { return sun_longitude_offset(t, angle); },
+            jd, SUN_MIN_DEGREES_PER_DAY, SUN_MAX_DEGREES_PER_DAY, EVENT_TOLERANCE_SECONDS, 0.000005).jd;
+    }
+
+    static astronomy::REAL calc_solar_term(int year, int idx) {
+        int angle = idx * 15;
+        return calc_solar_term_nearby(estimate_solar_term(year, angle), angle);
+    }
+
+    static astronomy::REAL clamp_degrees(astronomy::REAL d) {
+        while (d < 0) d += 360;
+        while (d > 360) d -= 360;
+        return d;
+    }
+
+    static astronomy::REAL ecliptic_longitude_diff(astronomy::REAL jd) {
+        return clamp_degrees(astronomy::get_moon_ecliptic_longitude(jd) - astronomy::get_sun_ecliptic_longitude(jd));
+    };
+
+    // 逐日搜索朔的天数上限
+    static constexpr int NEW_MOON_SCAN_DAYS = 30;
+
+    // jd0 + k·step（k = 0 ~ n - 1）各时刻的月日黄经差，n不超过NEW_MOON_SCAN_DAYS
+    // 用等间隔网格求和，每点的代价约为逐点计算的几分之一
+    static void ecliptic_longitude_diff_grid(astronomy::REAL jd0, astronomy::REAL step, int n, double *out) {
+        double sun[NEW_MOON_SCAN_DAYS];
+        astronomy::get_moon_ecliptic_longitude_grid(jd0, step, n, out);
+        astronomy::get_sun_ecliptic_longitude_grid(jd0, step, n, sun);
+        for (int k = 0; k < n; ++k) out[k] = (double)clamp_degrees(out[k] - sun[k]);
+    }
+
+    static inline astronomy::REAL estimate_new_moon_forward(astronomy::REAL jd) {
+        double D[NEW_MOON_SCAN_DAYS];
+        ecliptic_longitude_diff_grid(jd, 1, NEW_MOON_SCAN_DAYS, D);
+        for (int i = 1; i < NEW_MOON_SCAN_DAYS; ++i) {
+            if (D[i] < D[i - 1]) return jd + (i - 1);
+        }
+        return jd + (NEW_MOON_SCAN_DAYS - 1);
+    }
+
+    static astronomy::REAL estimate_new_moon_backward(astronomy::REAL jd) {
+        constexpr astronomy::REAL ONE_DAY = 360.0 / 29.53;
+        constexpr astronomy::REAL ONE_DAY_RVS = 1 / ONE_DAY;
+
+        astronomy::REAL D0, D1;
+        D0 = ecliptic_longitude_diff(jd);
+
+        if (D0 > ONE_DAY) {
+            jd -= D0 * ONE_DAY_RVS;
+            D1 = ecliptic_longitude_diff(jd);
+            if (D1 > D0) {
+                do {
+                    jd += 1;
+                    D1 = ecliptic_longitude_diff(jd);
+                } while (D1 > D0);
+                return jd - 1;
+            }
+            else if (D1 < D0) {
+                D0 = D1;
+                do {
+                    jd -= 1;
+                    D1 = ecliptic_longitude_diff(jd);
+                } while (D1 < D0);
+                return jd;
+            }
+
+            return jd;
+        }
+
+        double D[NEW_MOON_SCAN_DAYS];
+        ecliptic_longitude_diff_grid(jd, -1, NEW_MOON_SCAN_DAYS, D);
+        for (int i = 1; i < NEW_MOON_SCAN_DAYS; ++i) {
+            if (D[i] > D[i - 1]) return jd - i;
+        }
+        return jd - (NEW_MOON_SCAN_DAYS - 1);
+    }
+
+    static astronomy::bounded_t<astronomy::REAL> elongation_offset(astronomy::REAL jd, int angle) {
+        return { wrap_degrees_180(ecliptic_longitude_diff(jd) - angle), 0 };
+    }
+
+    // 月相：月日黄经差为angle的时刻，0朔、90上弦、180望、270下弦
+    static astronomy::REAL calc_moon_phase_nearby(astronomy::REAL jd, int angle) {
+        return solve_event_near([angle](astronomy::REAL t) { return elongation_offset(t, angle); },
+            jd, ELONGATION_MIN_DEGREES_PER_DAY, ELONGATION_MAX_DEGREES_PER_DAY, EVENT_TOLERANCE_SECONDS, 0.000005).jd;
+    }
+
+    static astronomy::REAL calc_new_moon_nearby(astronomy::REAL jd) {
+        return calc_moon_phase_nearby(jd, 0);
+    }
+
+    static inline astronomy::REAL calc_new_moon_nearby(int year, int month, int day) {
+        return calc_new_moon_nearby(astronomy::make_julian_day(year, month, day, 0, 0, 0));
+    }
+
+    // 低精度解，jd为力学时，err为误差上界（单位：日）
+    struct event_estimate_t {
+        astronomy::REAL jd;
+        astronomy::REAL err;
+    };
+
+    // 低精度档的节气，真实解落在[jd - err, jd + err]内
+    static event_estimate_t calc_solar_term_nearby_lite(astronomy::REAL jd, int angle) {
+        auto s = solve_event_near([angle](astronomy::REAL t) {
+            astronomy::bounded_t<double> d;
+            d.value = (double)wrap_degrees_180(astronomy::get_sun_ecliptic_longitude_lite(t, d.err) - angle);
+            return d;
+        }, jd, SUN_MIN_DEGREES_PER_DAY, SUN_MAX_DEGREES_PER_DAY, EVENT_LITE_TOLERANCE_SECONDS, 0.0001);
+        return { s.jd, (std::fabs(s.offset.value) + s.offset.err) / SUN_MIN_DEGREES_PER_DAY };
+    }
+
+    static inline event_estimate_t calc_solar_term_lite(int year, int idx) {
+        int angle = idx * 15;
+        return calc_solar_term_nearby_lite(estimate_solar_term(year, angle), angle);
+    }
+
+    static double ecliptic_longitude_diff_lite(astronomy::REAL jd, double &err) {
+        double em, es;
+        double d = astronomy::get_moon_ecliptic_longitude_lite(jd, em) - astronomy::get_sun_ecliptic_longitude_lite(jd, es);
+        err = em + es;
+        return d;
+    }
+
+    // 低精度档的月相，真实解落在[jd - err, jd + err]内
+    static event_estimate_t calc_moon_phase_nearby_lite(astronomy::REAL jd, int angle) {
+        auto s = solve_event_near([angle](astronomy::REAL t) {
+            astronomy::bounded_t<double> d;
+            d.value = (double)wrap_degrees_180(ecliptic_longitude_diff_lite(t, d.err) - angle);
+            return d;
+        }, jd, ELONGATION_MIN_DEGREES_PER_DAY, ELONGATION_MAX_DEGREES_PER_DAY, EVENT_LITE_TOLERANCE_SECONDS, 0.00001);
+        return { s.jd, (std::fabs(s.offset.value) + s.offset.err) / ELONGATION_MIN_DEGREES_PER_DAY };
+    }
+
+    static inline event_estimate_t calc_new_moon_nearby_lite(astronomy::REAL jd) {
+        return calc_moon_phase_nearby_lite(jd, 0);
+    }
+
+    // 误差区间换算成地方时后是否跨越了日界（jd为力学时）
+    static bool straddles_day_boundary(const event_estimate_t &e, astronomy::REAL tz) {
+        astronomy::REAL jd0 = e.jd - e.err + tz;
+        astronomy::REAL jd1 = e.jd + e.err + tz;
+        jd0 -= astronomy::calc_delta_t(jd0);
+        jd1 -= astronomy::calc_delta_t(jd1);
+        return floor(jd0 + 0.5) != floor(jd1 + 0.5);
+    }
+
+    // 带误差界的求解，f(jd)返回bounded_t<T>形式的角度差（度），rate为|f'|的下界（度/日），jd的误差在bracket日以内
+    // 返回的误差界对本级数是严格的：真实解与jd之差不超过(|f(jd)| + f的计算误差) / rate，与是否收敛无关
+    template <class T, class F>
+    static astronomy::bounded_t<T> solve_event_bounded(T jd, F &&f, double rate, T bracket, double tolerance_seconds) {
+        typedef astronomy::real_traits<T> R;
+        auto s = solve_event<T>(f, jd, jd - bracket, jd + bracket, tolerance_seconds, (T)0.000005, 16);
+        return { s.jd, (R::abs(s.offset.value) + s.offset.err) / (T)rate };
+    }
+
+    // 以下两个为带误差界的目标函数，包含减去目标角与归一化的舍入
+    template <class T>
+    static astronomy::bounded_t<T> sun_longitude_offset_bounded(T jd, int angle) {
+        typedef astronomy::real_traits<T> R;
+        astronomy::bounded_t<T> l = astronomy::get_sun_ecliptic_longitude_bounded<T>(jd);
+        T d = wrap_degrees_180(l.value - angle);
+        return { d, l.err + (R::abs(l.value) + 720) * 2 * R::unit_roundoff };
+    }
+
+    template <class T>
+    static astronomy::bounded_t<T> elongation_offset_bounded(T jd, int angle) {
+        typedef astronomy::real_traits<T> R;
+        astronomy::bounded_t<T> m = astronomy::get_moon_ecliptic_longitude_bounded<T>(jd);
+        astronomy::bounded_t<T> s = astronomy::get_sun_ecliptic_longitude_bounded<T>(jd);
+        T d = wrap_degrees_180(m.value - s.value - angle);
+        return { d, m.err + s.err + (R::abs(m.value) + R::abs(s.value) + 720) * 4 * R::unit_roundoff };
+    }
+
+    // 把力学时的误差区间换算成地方时（jd + tz - ΔT），若整个区间落在同一日则返回true
+    // local返回区间中点对应的地方时
+    template <class T>
+    static bool local_day_bounded(const astronomy::bounded_t<T> &e, astronomy::REAL tz, T &local) {
+        typedef astronomy::real_traits<T> R;
+        T lo = e.value - e.err + tz;
+        T hi = e.value + e.err + tz;
+        local = e.value + tz;
+        lo -= (T)astronomy::calc_delta_t((astronomy::REAL)lo);
+        hi -= (T)astronomy::calc_delta_t((astronomy::REAL)hi);
+        local -= (T)astronomy::calc_delta_t((astronomy::REAL)local);
+
+        // 换算本身的舍入，以及ΔT按long double计算的舍入
+        const T margin = R::abs(local) * 4 * R::unit_roundoff + 64 * LDBL_EPSILON;
+        return R::floor(lo - margin + (T)0.5) == R::floor(hi + margin + (T)0.5);
+    }
+
+    // 可证明正确的日界判断结果
+    struct certified_event_t {
+        astronomy::REAL jd;  // 力学时
+        astronomy::REAL local;  // 地方时，保证落在判定的那一日之内
+        int tier;  // 作出判断所用的精度：0低精度档 1 long double 2 __float128
+        bool ambiguous;  // 最高精度下误差区间仍然跨越日界，所在日无法确定
+    };
+
+    // 逐级提高精度，直到误差区间不再跨越日界
+    // f为泛型的带误差界目标函数，lite为低精度档的解
+    template <class F>
+    static certified_event_t certify_event(const event_estimate_t &lite, astronomy::REAL tz, double rate, F &&f) {
+        certified_event_t ce{ lite.jd, lite.jd + tz, 0, false };
+        ce.local -= astronomy::calc_delta_t(ce.local);
+        if (!straddles_day_boundary(lite, tz)) {
+            return ce;
+        }
+
+        astronomy::bounded_t<long double> e = solve_event_bounded<long double>(lite.jd, f, rate, 2 * lite.err + 1e-6L, EVENT_TOLERANCE_SECONDS);
+        long double local;
+        bool certain = local_day_bounded(e, tz, local);
+        ce.jd = e.value;
+        ce.local = local;
+        ce.tier = 1;
+        if (certain) {
+            return ce;
+        }
+
+#if ASTRONOMY_HAS_FLOAT128
+        astronomy::bounded_t<__float128> q = solve_event_bounded<__float128>((__float128)e.value, f, rate, (__float128)(2 * e.err + 1e-9L), 1e-19);
+        __float128 local_q;
+        certain = local_day_bounded(q, tz, local_q);
+        ce.jd = (astronomy::REAL)q.value;
+        ce.tier = 2;
+
+        // 转回long double时可能被舍入到日界另一侧，按四精度判定的日修正
+        const astronomy::REAL start = (astronomy::REAL)floorq(local_q + (__float128)0.5) - 0.5;
+        ce.local = (astronomy::REAL)local_q;
+        if (ce.local < start) ce.local = start;
+        else if (ce.local >= start + 1) ce.local = start + 1 - 1e-9;
+#endif
+
+        ce.ambiguous = !certain;
+        return ce;
+    }
+
+    // 以下两个由已求得的低精度档的解判定，同一个解可以按不同时区分别判定
+    static certified_event_t certify_solar_term(const event_estimate_t &lite, int idx, astronomy::REAL tz) {
+        const int angle = idx * 15;
+        return certify_event(lite, tz, SUN_MIN_DEGREES_PER_DAY, [angle](auto jd) {
+            return sun_longitude_offset_bounded(jd, angle);
+        });
+    }
+
+    static certified_event_t certify_new_moon(const event_estimate_t &lite, astronomy::REAL tz) {
+        return certify_event(lite, tz, ELONGATION_MIN_DEGREES_PER_DAY, [](auto jd) {
+            return elongation_offset_bounded(jd, 0);
+        });
+    }
+
+    struct moon_phase_t {
+        astronomy::REAL jd;  // 力学时
+        int phase;  // 0朔 1上弦 2望 3下弦
+    };
+
+    // 计算[jd_begin, jd_end)内的全部月相，按时间顺序回调visitor(const moon_phase_t &)
+    // 每个朔望月只解一次朔，两个相邻的朔构成区间，区间内月日黄经差单调增加，
+    // 按区间线性插值得到弦、望的初值，牛顿迭代通常两三次即收敛，不必再逐日扫描
+    template <class Visitor>
+    static void calc_moon_phases(astronomy::REAL jd_begin, astronomy::REAL jd_end, Visitor &&visitor) {
+        astronomy::REAL nm0 = calc_new_moon_nearby(estimate_new_moon_backward(jd_begin));
+        if (nm0 > jd_begin) {
+            nm0 = calc_new_moon_nearby(nm0 - 29.53);
+        }
+
+        while (nm0 < jd_end) {
+            astronomy::REAL nm1 = calc_new_moon_nearby(nm0 + 29.53);
+            astronomy::REAL len = nm1 - nm0;
+
+            moon_phase_t mp{ nm0, 0 };
+            if (mp.jd >= jd_begin) {
+                visitor(static_cast<const moon_phase_t &>(mp));
+            }
+
+            for (int i = 1; i < 4; ++i) {
+                mp.phase = i;
+                mp.jd = calc_moon_phase_nearby(nm0 + len * i * 0.25, i * 90);
+                if (mp.jd >= jd_end) {
+                    return;
+                }
+                if (mp.jd >= jd_begin) {
+                    visitor(static_cast<const moon_phase_t &>(mp));
+                }
+            }
+
+            nm0 = nm1;
+        }
+    }
+
+    // 计算一年的全部月相（按历年，非力学时）
+    template <class Visitor>
+    static void calc_moon_phases_for_year(int y, astronomy::REAL tz, Visitor &&visitor) {
+        // 粗略地把历年边界换成力学时，再多算一点，最后按转换后的日期筛选
+        astronomy::REAL jd_begin = astronomy::make_julian_day(y, 1, 1, 0, 0, 0.0) - tz;
+        astronomy::REAL jd_end = astronomy::make_julian_day(y + 1, 1, 1, 0, 0, 0.0) - tz;
+        jd_begin += astronomy::calc_delta_t(jd_begin);
+        jd_end += astronomy::calc_delta_t(jd_end);
+
+        calc_moon_phases(jd_begin, jd_end, visitor);
+    }
+
+    static constexpr const char *solar_terms_names[] = {
+        "小寒", "大寒", "立春", "雨水", "驚蟄", "春分", "清明", "穀雨", "立夏", "小滿", "芒種", "夏至",
+        "小暑", "大暑", "立秋", "處暑", "白露", "秋分", "寒露", "霜降", "立冬", "小雪", "大雪", "冬至"
+    };
+
+    static constexpr const char *month_names[] = {
+        "正月", "二月", "三月", "四月", "五月", "六月", "七月", "八月", "九月", "十月", "冬月", "臘月",
+    };
+
+    static constexpr const char *day_names[] = {
+        "初一", "初二", "初三", "初四", "初五", "初六", "初七", "初八", "初九", "初十",
+        "十一", "十二", "十三", "十四", "十五", "十六", "十七", "十八", "十九", "二十",
+        "廿一", "廿二", "廿三", "廿四", "廿五", "廿六", "廿七", "廿八", "廿九", "三十",
+    };
+
+    static constexpr const char *celestial_stems[10] = {
+        "甲", "乙", "丙", "丁", "戊", "己", "庚", "辛", "壬", "癸"
+    };
+
+    static constexpr const char *terrestrial_branches[12] = {
+        "子", "丑", "寅", "卯", "辰", "巳", "午", "未", "申", "酉", "戌", "亥"
+    };
+
+    // NOTE: 1928年及之前的农历用北京地方时116°23′E，1929年开始使用120°E平太阳时
+    // (116+23/60)*4*60=(465+8/15)*60=27932
+    static constexpr astronomy::REAL TIMEZONE_BEIJING = 8.0 / 24.0;
+    static constexpr astronomy::REAL TIMEZONE_BEIJING_LOCAL = 27932.0 / 86400.0;
+
+    // 时区规则：自某个农历年起使用的时区，单位为日
+    // 一个农历年（上年冬至至次年冬至的全部节气与朔）只用一个时区，与原来按1929年切换的做法一致
+    struct timezone_transition_t {
+        int since_year;
+        astronomy::REAL offset;
+    };
+
+    struct timezone_rule_t {
+        const char *name;
+        int count;
+        timezone_transition_t transitions[8];  // 按since_year升序
+    };
+
+    static astronomy::REAL timezone_offset(const timezone_rule_t &rule, int year) {
+        astronomy::REAL offset = rule.transitions[0].offset;
+        for (int i = 1; i < rule.count && year >= rule.transitions[i].since_year; ++i) {
+            offset = rule.transitions[i].offset;
+        }
+        return offset;
+    }
+
+    // 地方平太阳时，longitude为东经度数，西经为负
+    static inline timezone_rule_t timezone_from_longitude(const char *name, astronomy::REAL longitude) {
+        return { name, 1, { { INT_MIN, longitude / 360.0 } } };
+    }
+
+    // 固定时区，hours为UTC+hours
+    static timezone_rule_t timezone_fixed(const char *name, astronomy::REAL hours) {
+        return { name, 1, { { INT_MIN, hours / 24.0 } } };
+    }
+
+    // 中国：1928年及之前用北京地方时，1929年开始使用东八区
+    static const timezone_rule_t TIMEZONE_RULE_CHINA = { "China", 2, {
+        { INT_MIN, TIMEZONE_BEIJING_LOCAL },
+        { 1929, TIMEZONE_BEIJING },
+    } };
+
+    // 越南：1967年8月北越改用东七区编历，1968年戊申春节因此比中国早一日
+    static const timezone_rule_t TIMEZONE_RULE_VIETNAM = { "Vietnam", 2, {
+        { INT_MIN, 8.0 / 24.0 },
+        { 1968, 7.0 / 24.0 },
+    } };
+
+    // 韩国：1908年之前用汉城地方时126°58′E，之后依标准时的变更在东八区半与东九区之间切换
+    static const timezone_rule_t TIMEZONE_RULE_KOREA = { "Korea", 5, {
+        { INT_MIN, (126.0 + 58.0 / 60.0) / 360.0 },
+        { 1908, 8.5 / 24.0 },
+        { 1912, 9.0 / 24.0 },
+        { 1954, 8.5 / 24.0 },
+        { 1961, 9.0 / 24.0 },
+    } };
+
+    static constexpr const char *moon_phase_names[] = {
+        "朔", "上弦", "望", "下弦"
+    };
+
+    enum calc_mode_t {
+        CALC_FULL,  // 全部节气、朔都用全精度求解
+        CALC_ADAPTIVE,  // 先用低精度档求解，只有误差区间跨越日界的才用全精度重解，排出的日期与CALC_FULL相同
+        CALC_CERTIFIED,  // 带误差界求解，跨越日界的逐级升到long double、__float128，仍无法确定的标记为“？”
+    };
+
+    enum event_type_t {
+        EVENT_SOLAR_TERM,
+        EVENT_MOON_PHASE,
+    };
+
+    // 事件流所含的事件，可组合
+    enum {
+        EVENTS_SOLAR_TERMS = 1,
+        EVENTS_NEW_MOONS = 2,
+        EVENTS_MOON_QUARTERS = 4,  // 上弦、望、下弦
+        EVENTS_ALL = 7,
+    };
+
+    // 天象事件
+    struct astro_event_t {
+        astronomy::REAL jd;  // 力学时
+        astronomy::REAL err;  // 真实解落在[jd - err, jd + err]内，全精度时为0
+        event_type_t type;
+        int index;  // 节气：0小寒 ~ 23冬至，与solar_terms_names相同；月相：0朔 1上弦 2望 3下弦
+        int angle;  // 太阳视黄经，或月日黄经差
+    };
+
+    // 按时间顺序逐个拉取的事件流，可向后或向前，无范围限制
+    // 每类事件只预先求解下一个，下一个的初值由上一个的解外推，每个事件只求解一次
+    class event_stream {
+    public:
+        // 空流，不求解任何事件，须赋值后再用
+        event_stream() : _forward(true), _lite(false), _kinds(0) {
+        }
+
+        // forward为true时依次给出jd >= start的事件，否则依次给出jd < start的事件（时间倒序），start为力学时
+        // mode为CALC_FULL时全精度求解，其余为低精度档，是否重解由调用者决定
+        explicit event_stream(astronomy::REAL start, int kinds = EVENTS_ALL, bool forward = true, calc_mode_t mode = CALC_FULL)
+            : _forward(forward), _lite(mode != CALC_FULL), _kinds(kinds) {
+            _sun.enabled = (kinds & EVENTS_SOLAR_TERMS) != 0;
+            _sun.step = 15;
+            _sun.rate = 360.0 / 365.2422;
+            if (_sun.enabled) {
+                init(_sun, start, astronomy::get_sun_ecliptic_longitude(start));
+            }
+
+            _moon.enabled = (kinds & (EVENTS_NEW_MOONS | EVENTS_MOON_QUARTERS)) != 0;
+            _moon.step = (kinds & EVENTS_MOON_QUARTERS) ? 90 : 360;
+            _moon.rate = 360.0 / 29.530589;
+            if (_moon.enabled) {
+                init(_moon, start, ecliptic_longitude_diff(start));
+            }
+        }
+
+        // 下一个事件，不消耗
+        const astro_event_t &peek() const {
+            return pick();
+        }
+
+        astro_event_t next() {
+            const astro_event_t &e = pick();
+            astro_event_t r = e;
+            advance(&e == &_sun.pending ? _sun : _moon);
+            return r;
+        }
+
+    private:
+        struct channel_t {
+            bool enabled;
+            int step;  // 相邻事件的角度差
+            astronomy::REAL rate;  // 平均每日变化的角度，用于外推初值
+            astro_event_t pending;
+        };
+
+        const astro_event_t &pick() const {
+            if (!_moon.enabled) return _sun.pending;
+            if (!_sun.enabled) return _moon.pending;
+            const bool sun_first = _forward ? _sun.pending.jd <= _moon.pending.jd : _sun.pending.jd >= _moon.pending.jd;
+            return sun_first ? _sun.pending : _moon.pending;
+        }
+
+        bool wanted(const channel_t &c) const {
+            if (&c == &_sun) return true;
+            return (c.pending.angle == 0) ? (_kinds & EVENTS_NEW_MOONS) != 0 : (_kinds & EVENTS_MOON_QUARTERS) != 0;
+        }
+
+        void solve(channel_t &c, astronomy::REAL guess, int angle) {
+            astro_event_t &e = c.pending;
+            e.angle = angle;
+            if (&c == &_sun) {
+                e.type = EVENT_SOLAR_TERM;
+                e.index = (angle / 15 + 5) % 24;
+                if (_lite) {
+                    event_estimate_t est = calc_solar_term_nearby_lite(guess, angle);
+                    e.jd = est.jd;
+                    e.err = est.err;
+                }
+                else {
+                    e.jd = calc_solar_term_nearby(guess, angle);
+                    e.err = 0;
+                }
+            }
+            else {
+                e.type = EVENT_MOON_PHASE;
+                e.index = angle / 90;
+                if (_lite) {
+                    event_estimate_t est = calc_moon_phase_nearby_lite(guess, angle);
+                    e.jd = est.jd;
+                    e.err = est.err;
+                }
+                else {
+                    e.jd = calc_moon_phase_nearby(guess, angle);
+                    e.err = 0;
+                }
+            }
+        }
+
+        // 由start时刻的角度lon找到第一个目标角
+        void init(channel_t &c, astronomy::REAL start, astronomy::REAL lon) {
+            lon = clamp_degrees(lon);
+            const int k = (int)std::floor(lon / c.step);
+            if (_forward) {
+                const int angle = (k + 1) * c.step % 360;
+                solve(c, start + clamp_degrees(angle - lon) / c.rate, angle);
+                while (c.pending.jd < start || !wanted(c)) advance(c);
+            }
+            else {
+                const int angle = k * c.step % 360;
+                solve(c, start - clamp_degrees(lon - angle) / c.rate, angle);
+                while (c.pending.jd >= start || !wanted(c)) advance(c);
+            }
+        }
+
+        void advance(channel_t &c) {
+            do {
+                const astronomy::REAL jd = c.pending.jd;
+                if (_forward) {
+                    solve(c, jd + c.step / c.rate, (c.pending.angle + c.step) % 360);
+                }
+                else {
+                    solve(c, jd - c.step / c.rate, (c.pending.angle + 360 - c.step) % 360);
+                }
+            } while (!wanted(c));
+        }
+
+        bool _forward;
+        bool _lite;
+        int _kinds;
+        channel_t _sun{};
+        channel_t _moon{};
+    };
+
+    // 农历月
+    struct lunar_month_t {
+        astronomy::day_number_t first_day;  // 朔日
+        int month;  // 1~12
+        bool leap;
+        bool major;  // 大月30日，小月29日
+        bool ambiguous;  // 朔日或下月朔日无法确定，仅CALC_CERTIFIED
+        astronomy::REAL jd;  // 朔，力学时
+        astronomy::REAL local;  // 朔，地方时
+    };
+
+    // 节气
+    struct solar_term_day_t {
+        astronomy::day_number_t day;
+        int index;  // 0小寒 ~ 23冬至，与solar_terms_names相同
+        bool ambiguous;  // 所在日无法确定，仅CALC_CERTIFIED
+        astronomy::REAL jd;  // 力学时
+        astronomy::REAL local;  // 地方时
+    };
+
+    // 农历年：正月初一至次年正月初一的前一日，以及落在其中的节气
+    struct lunar_year_t {
+        int year;
+        int month_count;  // 12或13
+        int leap_month;  // 闰几月，无闰为0
+        astronomy::day_number_t end_day;  // 次年正月初一
+        lunar_month_t months[13];
+        int term_count;
+        solar_term_day_t terms[26];
+    };
+
+    // 支持的年份范围，即ΔT表（astronomy::impl::D）覆盖的年份；超出时ΔT的外推没有意义，求解也随年份增大而变慢
+    // 接受外部输入的查询与接口在计算之前先检查
+    static constexpr int MIN_LUNAR_YEAR = -4000;
+    static constexpr int MAX_LUNAR_YEAR = 5999;
+
+    static inline bool lunar_year_supported(int y) {
+        return y >= MIN_LUNAR_YEAR && y <= MAX_LUNAR_YEAR;
+    }
+
+    // 一个农历年所需的全部节气与朔，均为力学时，与时区无关
+    // CALC_FULL为全精度解；CALC_ADAPTIVE时跨越任一所需时区日界的已换成全精度解，其余为低精度档的解；
+    // CALC_CERTIFIED时均为低精度档的解，归日时再按各时区逐级判定
+    struct lunar_year_events_t {
+        int year;
+        calc_mode_t mode;
+        // 下标0、1是上年小雪、大雪，2是上年冬至，26是今年冬至，50是下年冬至
+        event_estimate_t solar_terms[51];
+        // 下标1是不晚于上年冬至的最后一个朔，0是其前一个朔
+        event_estimate_t new_moons[30];
+    };
+
+    // 事件流应从上年冬至前两个多月开始，保证上年冬至所在月的朔及其前一个朔都在流中
+    static astronomy::REAL lunar_year_events_start(int y) {
+        return estimate_solar_term(y - 1, 270) - 70;
+    }
+
+    // CALC_ADAPTIVE时，低精度解的误差区间跨越任一时区的日界则改用全精度解，误差为0，之后不会再重解
+    static event_estimate_t refine_lunar_year_event(const astro_event_t &e, const astronomy::REAL *tz, int tz_count, calc_mode_t mode) {
+        if (mode == CALC_ADAPTIVE) {
+            for (int i = 0; i < tz_count; ++i) {
+                if (straddles_day_boundary({ e.jd, e.err }, tz[i])) {
+                    return { e.type == EVENT_SOLAR_TERM ? calc_solar_term_nearby(e.jd, e.angle) : calc_new_moon_nearby(e.jd), 0 };
+                }
+            }
+        }
+        return { e.jd, e.err };
+    }
+
+    // 从按时间顺序给出节气与朔的事件源中取出一个农历年所需的全部事件，source.next()返回astro_event_t
+    // tz为之后要归日的各个时区，只在CALC_ADAPTIVE时用于判断是否需要全精度重解
+    template <class Source>
+    static void collect_lunar_year_events(int y, Source &source, const astronomy::REAL *tz, int tz_count, calc_mode_t mode, lunar_year_events_t &ev) {
+        constexpr int LESSER_SNOW_INDEX = 21;  // 小雪
+
+        auto refine = [mode, tz, tz_count](const astro_event_t &e) {
+            return refine_lunar_year_event(e, tz, tz_count, mode);
+        };
+
+        ev.year = y;
+        ev.mode = mode;
+
+        // 上年小雪~下年冬至共51个节气；朔先全部留下，最后从上年冬至所在月的前一个开始取30个
+        event_estimate_t new_moons[34];
+        int term_count = 0, moon_count = 0, first = -1;
+        while (term_count < 51 || first < 0 || moon_count < first + 30) {
+            const astro_event_t e = source.next();
+            if (e.type == EVENT_SOLAR_TERM) {
+                if (term_count == 0 && e.index != LESSER_SNOW_INDEX) continue;
+                if (term_count == 51) continue;
+                ev.solar_terms[term_count++] = refine(e);
+            }
+            else if (e.index == 0) {
+                // 上年冬至已求得，第一个晚于它的朔的前两个即为new_moons[0]
+                if (first < 0 && term_count > 2 && e.jd > ev.solar_terms[2].jd) {
+                    first = moon_count - 2;
+                }
+                if (moon_count < 34) new_moons[moon_count++] = refine(e);
+            }
+        }
+
+        for (int i = 0; i < 30; ++i) {
+            ev.new_moons[i] = new_moons[first + i];
+        }
+    }
+
+    // 求解一次，节气与朔取自同一个事件流，按时间顺序各求解一次
+    // 只算一年；连续多年用lunar_year_solver，相邻两年重叠的事件不再重解
+    static void solve_lunar_year_events(int y, const astronomy::REAL *tz, int tz_count, calc_mode_t mode, lunar_year_events_t &ev) {
+        event_stream stream(lunar_year_events_start(y), EVENTS_SOLAR_TERMS | EVENTS_NEW_MOONS, true, mode);
+        collect_lunar_year_events(y, stream, tz, tz_count, mode, ev);
+    }
+
+    // 连续多年共用一个事件流：一年所需的事件从上年冬至前约70日至下年冬至，与下一年的重叠一大半（本年冬至前70日起的），
+    // 已求得的事件留在窗口中，下一年从窗口中本年起点之后的事件接着取，每个节气与朔只求解一次
+    // 结果与solve_lunar_year_events相同（全精度档的差别在求解的收敛阈值之内）
+    // 年份不接续上次时从该年的起点重开事件流，与solve_lunar_year_events的代价相同
+    // CALC_ADAPTIVE时窗口中的事件按各年的时区判断是否重解，重解后的结果留在窗口中
+    // 窗口为定长的环形缓冲，不分配内存
+    class lunar_year_solver {
+    public:
+        explicit lunar_year_solver(calc_mode_t mode = CALC_FULL) : _mode(mode) {
+        }
+
+        calc_mode_t mode() const { return _mode; }
+
+        // 丢弃窗口，下次从头求解
+        void reset() {
+            _next_year = INT_MIN;
+        }
+
+        void solve(int y, const astronomy::REAL *tz, int tz_count, lunar_year_events_t &ev) {
+            const astronomy::REAL start = lunar_year_events_start(y);
+            if (y != _next_year) {
+                _stream = event_stream(start, EVENTS_SOLAR_TERMS | EVENTS_NEW_MOONS, true, _mode);
+                _head = _count = 0;
+            }
+            while (_count > 0 && at(0).jd < start) {
+                _head = (_head + 1) % WINDOW_EVENTS;
+                --_count;
+            }
+
+            source_t source{ *this, tz, tz_count, 0 };
+            collect_lunar_year_events(y, source, tz, tz_count, _mode, ev);
+            _next_year = source.overflow ? INT_MIN : y + 1;
+        }
+
+    private:
+        // 一年所需约85个事件，窗口不会满；万一满了，超出的事件不留，下一年从头求解
+        static constexpr std::size_t WINDOW_EVENTS = 160;
+
+        // 先按顺序给出窗口中的事件，取完再从事件流中取并留在窗口中
+        struct source_t {
+            lunar_year_solver &solver;
+            const astronomy::REAL *tz;
+            int tz_count;
+            std::size_t pos;
+            bool overflow = false;
+
+            astro_event_t next() {
+                if (pos == solver._count) {
+                    const astro_event_t e = solver._stream.next();
+                    if (solver._count == WINDOW_EVENTS) {
+                        overflow = true;
+                        return e;
+                    }
+                    solver.at(solver._count++) = e;
+                }
+                astro_event_t &e = solver.at(pos++);
+                const event_estimate_t r = refine_lunar_year_event(e, tz, tz_count, solver._mode);
+                e.jd = r.jd;
+                e.err = r.err;
+                return e;
+            }
+        };
+
+        astro_event_t &at(std::size_t i) {
+            return _events[(_head + i) % WINDOW_EVENTS];
+        }
+
+        calc_mode_t _mode;
+        int _next_year = INT_MIN;
+        event_stream _stream;
+        astro_event_t _events[WINDOW_EVENTS];
+        std::size_t _head = 0, _count = 0;
+    };
+
+    // 归入地方时的日的节气或朔
+    struct binned_event_t {
+        astronomy::REAL jd;  // 力学时
+        astronomy::REAL local;  // 地方时
+        int ofst;
+        bool ambiguous;  // 所在日无法确定，仅CALC_CERTIFIED
+
+        void set(astronomy::REAL jd) {
+            set_local(jd - astronomy::calc_delta_t(jd));
+        }
+
+        void set_local(astronomy::REAL jd) {
+            local = jd;
+            ofst = (astronomy::day_number_t)std::floor(jd + 0.5);
+        }
+
+        void set_certified(const certified_event_t &ce) {
+            set_local(ce.local);
+            ambiguous = ce.ambiguous;
+        }
+    };
+
+    // 已归日、尚未排月的农历年，下标同bin_lunar_year_days中的说明
+    struct binned_lunar_year_t {
+        int year;
+        int nm_idx;  // 上年冬至所在月的朔在new_moons中的下标，0或1
+        binned_event_t solar_terms[51], new_moons[28];
+    };
+
+    // 按时区把已求得的节气与朔归入地方时的日（力学时换算为世界时再加时区）
+    static void bin_lunar_year_days(const lunar_year_events_t &ev, astronomy::REAL tz, binned_lunar_year_t &b) {
+        const calc_mode_t mode = ev.mode;
+
+        auto bin_solar_term = [mode, tz](binned_event_t &st, const event_estimate_t &e, int idx) {
+            if (mode == CALC_CERTIFIED) {
+                certified_event_t ce = certify_solar_term(e, idx, tz);
+                st.set_certified(ce);
+                st.jd = ce.jd;
+                return;
+            }
+            st.set(e.jd + tz);
+            st.jd = e.jd;
+        };
+
+        auto bin_new_moon = [mode, tz](binned_event_t &nm, const event_estimate_t &e) {
+            if (mode == CALC_CERTIFIED) {
+                certified_event_t ce = certify_new_moon(e, tz);
+                nm.set_certified(ce);
+                nm.jd = ce.jd;
+                return;
+            }
+            nm.set(e.jd + tz);
+            nm.jd = e.jd;
+        };
+
+        // 由于农历的置闰是以冬至为锚点的，11、12月是否闰取决于上一个周期，而1~10月是否闰取决于下一个周期
+        // 这里为了显示，把节气也显示出来，所以需要24*2，多出来的3是上一年的小雪、大雪、冬至
+        // 朔日需要本来只需要计算26个，又因为如果冬至离朔日很近的时候，可能迭代到上一个月的，加之腊月需要显示大小，故有28
+        b = binned_lunar_year_t();
+        b.year = ev.year;
+        binned_event_t *solar_terms = b.solar_terms, *new_moons = b.new_moons;
+
+        // 下标i的节气按角度为(i + 16) % 24 * 15度，下标2为冬至270度
+        for (int i = 0; i < 51; ++i) {
+            bin_solar_term(solar_terms[i], ev.solar_terms[i], (i + 16) % 24);
+        }
+
+        // 上年冬至、以及上年冬至之前的朔
+        // 下标0和1是小雪、大雪，这两个有可能跟冬至在同一个月（概率较小）
+        // 下标0预留冬至之前的朔
+        // first为new_moons[1]在ev.new_moons中的下标
+        int nm_idx = 1, first = 1;
+        bin_new_moon(new_moons[1], ev.new_moons[1]);
+
+        // 如果朔比冬至大，则说明迭代到下一个月的朔了，需要检查更早一个朔
+        if (new_moons[1].ofst > solar_terms[2].ofst) {
+            bin_new_moon(new_moons[0], ev.new_moons[0]);
+            if (new_moons[0].ofst < solar_terms[2].ofst) {
+                nm_idx = 0;
+            }
+        }
+        else {
+            bin_new_moon(new_moons[2], ev.new_moons[2]);
+            if (new_moons[2].ofst == solar_terms[2].ofst) {
+                new_moons[1] = new_moons[2];
+                first = 2;
+            }
+        }
+
+        for (int i = 2; i < 28; ++i) {
+            bin_new_moon(new_moons[i], ev.new_moons[first + i - 1]);
+        }
+        b.nm_idx = nm_idx;
+    }
+
+    // 由归日后的节气与朔定闰月、排出各月
+    static void label_lunar_year(const binned_lunar_year_t &b, lunar_year_t &ly) {
+        const int y = b.year;
+        const binned_event_t *solar_terms = b.solar_terms, *new_moons = b.new_moons;
+        int nm_idx = b.nm_idx;
+        int leap = 0;
+
+        // 闰月在上年冬至~今年冬至区间
+        // solar_terms[26]为今年冬至
+        if (solar_terms[26].ofst >= new_moons[nm_idx + 13].ofst) {
+            int ms_idx = 2, o;
+            for (int i = 0; i < 13; ++i) {
+                o = solar_terms[ms_idx].ofst;
+                if (new_moons[nm_idx + i + 1].ofst <= o) {
+                    leap = nm_idx + i;
+                    break;
+                }
+                ms_idx += 2;
+            }
+        }
+        // 闰月在今年冬至~下年冬至区间
+        // solar_terms[50]为下年冬至
+        else if (solar_terms[50].ofst >= new_moons[nm_idx + 25].ofst) {
+            int ms_idx = 26, o;
+            for (int i = 0; i < 13; ++i) {
+                o = solar_terms[ms_idx].ofst;
+                if (new_moons[nm_idx + i + 13].ofst <= o) {
+                    leap = nm_idx + i + 12;
+                    break;
+                }
+                ms_idx += 2;
+            }
+        }
+
+        ly.year = y;
+        ly.month_count = 0;
+        ly.leap_month = 0;
+        ly.term_count = 0;
+        ly.end_day = 0;
+
+        for (; nm_idx < 16; ++nm_idx) {
+            // 按年取正月至臘月
+            if (leap == 0 ? (nm_idx < 3 || nm_idx > 14) : (nm_idx < (leap >= 4 ? 3 : 4) || nm_idx > (leap <= 15 ? 15 : 14))) {
+                continue;
+            }
+
+            const auto &mn0 = new_moons[nm_idx];
+            const auto &mn1 = new_moons[nm_idx + 1];
+
+            lunar_month_t &m = ly.months[ly.month_count++];
+            m.first_day = mn0.ofst;
+            m.leap = leap != 0 && nm_idx == leap;
+            // 无闰、或本月在闰月之前；有闰且本月在闰月或者之后
+            m.month = (leap == 0 || nm_idx < leap) ? (nm_idx + 9) % 12 + 1 : (nm_idx + 8) % 12 + 1;
+            m.major = (mn1.ofst - mn0.ofst) == 30;
+            m.ambiguous = mn0.ambiguous || mn1.ambiguous;
+            m.jd = mn0.jd;
+            m.local = mn0.local;
+            if (m.leap) {
+                ly.leap_month = m.month;
+            }
+
+            ly.end_day = mn1.ofst;
+        }
+
+        // 落在本年内的节气
+        for (int i = 0; i < 51; ++i) {
+            const auto &st = solar_terms[i];
+            if (st.ofst < ly.months[0].first_day || st.ofst >= ly.end_day) {
+                continue;
+            }
+
+            solar_term_day_t &t = ly.terms[ly.term_count++];
+            t.day = st.ofst;
+            t.index = (i + 21) % 24;
+            t.ambiguous = st.ambiguous;
+            t.jd = st.jd;
+            t.local = st.local;
+        }
+    }
+
+    // 按时区把已求得的节气与朔归入地方时的日，排出农历年
+    static void bin_lunar_year(const lunar_year_events_t &ev, astronomy::REAL tz, lunar_year_t &ly) {
+        binned_lunar_year_t b;
+        bin_lunar_year_days(ev, tz, b);
+        label_lunar_year(b, ly);
+    }
+
+    static void calc_lunar_year(int y, lunar_year_t &ly, calc_mode_t mode = CALC_FULL, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+        const astronomy::REAL tz = timezone_offset(rule, y);
+        lunar_year_events_t ev;
+        solve_lunar_year_events(y, &tz, 1, mode, ev);
+        bin_lunar_year(ev, tz, ly);
+    }
+
+    // 同一年多个时区的农历，节气与朔只求解一次，out须有count个
+    static inline void calc_lunar_year_variants(int y, const timezone_rule_t *rules, int count, lunar_year_t *out, calc_mode_t mode = CALC_FULL) {
+        // 每次最多按16个时区判断是否需要重解，超出的分批
+        for (int base = 0; base < count; base += 16) {
+            const int n = count - base < 16 ? count - base : 16;
+            astronomy::REAL tz[16];
+            for (int i = 0; i < n; ++i) {
+                tz[i] = timezone_offset(rules[base + i], y);
+            }
+
+            lunar_year_events_t ev;
+            solve_lunar_year_events(y, tz, n, mode, ev);
+            for (int i = 0; i < n; ++i) {
+                bin_lunar_year(ev, tz[i], out[base + i]);
+            }
+        }
+    }
+
+    // 农历日期
+    struct lunar_date_t {
+        int year;  // 农历年，以正月初一为界
+        int month;  // 1~12
+        bool leap;
+        int day;  // 1~30
+    };
+
+    // day不在ly内时返回false
+    static bool lunar_date_from_day(const lunar_year_t &ly, astronomy::day_number_t day, lunar_date_t &ld) {
+        if (day < ly.months[0].first_day || day >= ly.end_day) return false;
+        int i = ly.month_count - 1;
+        while (day < ly.months[i].first_day) --i;
+        ld.year = ly.year;
+        ld.month = ly.months[i].month;
+        ld.leap = ly.months[i].leap;
+        ld.day = day - ly.months[i].first_day + 1;
+        return true;
+    }
+
+    // ly中没有该月（例如无此闰月），或该月没有该日（小月三十）时返回false
+    static bool day_from_lunar_date(const lunar_year_t &ly, int month, bool leap, int day, astronomy::day_number_t &out) {
+        for (int i = 0; i < ly.month_count; ++i) {
+            const lunar_month_t &m = ly.months[i];
+            if (m.month == month && m.leap == leap) {
+                if (day < 1 || day > (m.major ? 30 : 29)) return false;
+                out = m.first_day + day - 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 逐日记录
+    struct day_record_t {
+        astronomy::day_number_t day;
+        int year, month, mday;  // 公历日期，1582-10-15之前为儒略历
+        int lunar_year;  // 农历年，以正月初一为界
+        int lunar_month;  // 1~12
+        bool leap;
+        int lunar_day;  // 1~30
+        int sexagenary;  // 干支日序，0为甲子
+        int solar_term;  // 当日所交节气（0小寒 ~ 23冬至），没有则为-1
+    };
+
+    // 逐日迭代器，可前后移动
+    // 只保存当前所在的农历年，进入另一个农历年时才计算该年，内存占用与区间长度无关
+    class day_iterator {
+    public:
+        // rule须在迭代器的生存期内有效
+        explicit day_iterator(astronomy::day_number_t day, calc_mode_t mode = CALC_ADAPTIVE, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA)
+            : _day(day), _mode(mode), _rule(&rule) {
+        }
+
+        const day_record_t &operator*() {
+            load();
+            return _record;
+        }
+
+        const day_record_t *operator->() {
+            load();
+            return &_record;
+        }
+
+        day_iterator &operator++() {
+            ++_day;
+            return *this;
+        }
+
+        day_iterator &operator--() {
+            --_day;
+            return *this;
+        }
+
+        bool operator==(const day_iterator &other) const { return _day == other._day; }
+        bool operator!=(const day_iterator &other) const { return _day != other._day; }
+
+        astronomy::day_number_t day() const { return _day; }
+
+    private:
+        bool in_year() const {
+            return _loaded && _day >= _year.months[0].first_day && _day < _year.end_day;
+        }
+
+        void enter_year(int y) {
+            calc_lunar_year(y, _year, _mode, *_rule);
+            _loaded = true;
+            _month_idx = 0;
+            _term_idx = 0;
+        }
+
+        void load() {
+            if (_record_valid && _record.day == _day) {
+                return;
+            }
+
+            if (!in_year()) {
+                // 相邻的年直接进入，否则按公历年猜测
+                if (_loaded && _day == _year.end_day) {
+                    enter_year(_year.year + 1);
+                }
+                else if (_loaded && _day == _year.months[0].first_day - 1) {
+                    enter_year(_year.year - 1);
+                }
+                else {
+                    int y, m, d;
+                    astronomy::civil_from_day_number(_day, &y, &m, &d);
+                    enter_year(y + (y < 0));
+                }
+                while (_day < _year.months[0].first_day) enter_year(_year.year - 1);
+                while (_day >= _year.end_day) enter_year(_year.year + 1);
+            }
+
+            while (_month_idx > 0 && _day < _year.months[_month_idx].first_day) --_month_idx;
+            while (_month_idx + 1 < _year.month_count && _day >= _year.months[_month_idx + 1].first_day) ++_month_idx;
+            while (_term_idx > 0 && _year.terms[_term_idx - 1].day >= _day) --_term_idx;
+            while (_term_idx < _year.term_count && _year.terms[_term_idx].day < _day) ++_term_idx;
+
+            const lunar_month_t &m = _year.months[_month_idx];
+            day_record_t &r = _record;
+            r.day = _day;
+            astronomy::civil_from_day_number(_day, &r.year, &r.month, &r.mday);
+            r.lunar_year = _year.year;
+            r.lunar_month = m.month;
+            r.leap = m.leap;
+            r.lunar_day = _day - m.first_day + 1;
+            r.sexagenary = astronomy::sexagenary_day(_day);
+            r.solar_term = (_term_idx < _year.term_count && _year.terms[_term_idx].day == _day) ? _year.terms[_term_idx].index : -1;
+            _record_valid = true;
+        }
+
+        astronomy::day_number_t _day;
+        calc_mode_t _mode;
+        const timezone_rule_t *_rule;
+        bool _loaded = false;
+        bool _record_valid = false;
+        int _month_idx = 0;
+        int _term_idx = 0;
+        lunar_year_t _year;
+        day_record_t _record;
+    };
+
+    // [first, last)的逐日区间，可用于range-for
+    class day_range {
+    public:
+        day_range(astronomy::day_number_t first, astronomy::day_number_t last, calc_mode_t mode = CALC_ADAPTIVE, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA)
+            : _first(first), _last(last), _mode(mode), _rule(&rule) {
+        }
+
+        day_iterator begin() const { return day_iterator(_first, _mode, *_rule); }
+        day_iterator end() const { return day_iterator(_last, _mode, *_rule); }
+
+    private:
+        astronomy::day_number_t _first, _last;
+        calc_mode_t _mode;
+        const timezone_rule_t *_rule;
+    };
+}
+
+#endif
@@ -0,0 +1,139 @@
+﻿#define CHNCAL_BUILD
+#include "chncal.h"
+#include "calendar.h"
+#include "context.h"
+#include <new>
+
+// C接口的上下文即calendar_context，农历年缓存64个槽，构造后不再分配内存
+struct chncal_context {
+    calendar::calendar_context ctx;
+
+    chncal_context(calendar::calc_mode_t mode, const calendar::timezone_rule_t &rule) : ctx(mode, rule, 64) {
+    }
+};
+
+static_assert(CHNCAL_MIN_YEAR == calendar::MIN_LUNAR_YEAR && CHNCAL_MAX_YEAR == calendar::MAX_LUNAR_YEAR, "year range differs from calendar.h");
+
+// 拒绝不存在的日期，例如2月30日、1582-10-05 ~ 1582-10-14，以及超出支持范围的年份
+static bool valid_date(int year, int month, int day) {
+    if (year == 0 || !calendar::lunar_year_supported(year) || month < 1 || month > 12 || day < 1 || day > 31) return false;
+    int y, m, d;
+    astronomy::civil_from_day_number(astronomy::day_number_from_civil(year, month, day), &y, &m, &d);
+    return y == year && m == month && d == day;
+}
+
+static chncal_context *create_context(int mode, const calendar::timezone_rule_t &rule) {
+    if (mode < CHNCAL_MODE_FULL || mode > CHNCAL_MODE_CERTIFIED) return nullptr;
+    return new (std::nothrow) chncal_context((calendar::calc_mode_t)mode, rule);
+}
+
+extern "C" {
+
+CHNCAL_API int chncal_abi_version(void) {
+    return CHNCAL_ABI_VERSION;
+}
+
+CHNCAL_API chncal_context *chncal_context_create(int mode, int timezone) {
+    switch (timezone) {
+    case CHNCAL_TZ_CHINA: return create_context(mode, calendar::TIMEZONE_RULE_CHINA);
+    case CHNCAL_TZ_VIETNAM: return create_context(mode, calendar::TIMEZONE_RULE_VIETNAM);
+    case CHNCAL_TZ_KOREA: return create_context(mode, calendar::TIMEZONE_RULE_KOREA);
+    default: return nullptr;
+    }
+}
+
+CHNCAL_API chncal_context *chncal_context_create_fixed(int mode, double hours) {
+    return create_context(mode, calendar::timezone_fixed("fixed", hours));
+}
+
+CHNCAL_API void chncal_context_destroy(chncal_context *ctx) {
+    delete ctx;
+}
+
+CHNCAL_API size_t chncal_gregorian_to_lunar(chncal_context *ctx, const chncal_date *in, size_t n, chncal_lunar_date *out) {
+    if (ctx == nullptr) return 0;
+    size_t ok = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = chncal_lunar_date{ 0, 0, 0, 0 };
+        if (!valid_date(in[i].year, in[i].month, in[i].day)) continue;
+
+        const astronomy::day_number_t day = astronomy::day_number_from_civil(in[i].year, in[i].month, in[i].day);
+        calendar::lunar_date_t ld;
+        if (!calendar::lunar_date_from_day(ctx->ctx, day, ld)) continue;
+        out[i] = chncal_lunar_date{ ld.year, ld.month, ld.leap ? 1 : 0, ld.day };
+        ++ok;
+    }
+    return ok;
+}
+
+CHNCAL_API size_t chncal_lunar_to_gregorian(chncal_context *ctx, const chncal_lunar_date *in, size_t n, chncal_date *out) {
+    if (ctx == nullptr) return 0;
+    size_t ok = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = chncal_date{ 0, 0, 0 };
+        if (!calendar::lunar_year_supported(in[i].year) || in[i].month < 1 || in[i].month > 12) continue;
+
+        const calendar::lunar_date_t ld = { in[i].year, in[i].month, in[i].leap != 0, in[i].day };
+        astronomy::day_number_t day;
+        if (!calendar::day_from_lunar_date(ctx->ctx, ld, day)) continue;
+        astronomy::civil_from_day_number(day, &out[i].year, &out[i].month, &out[i].day);
+        ++ok;
+    }
+    return ok;
+}
+
+CHNCAL_API size_t chncal_solar_terms(chncal_context *ctx, const int *years, size_t n, double *out) {
+    if (ctx == nullptr) return 0;
+    size_t ok = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const bool supported = calendar::lunar_year_supported(years[i]);
+        for (int k = 0; k < 24; ++k) {
+            if (!supported) {
+                out[i * 24 + k] = 0;
+                continue;
+            }
+            const astronomy::REAL jd = calendar::calc_solar_term(years[i], k >= 5 ? k - 5 : k + 19);
+            out[i * 24 + k] = (double)(jd - astronomy::calc_delta_t(jd));
+        }
+        ok += supported;
+    }
+    return ok;
+}
+
+CHNCAL_API size_t chncal_new_moons_after(chncal_context *ctx, const double *jd_ut, size_t n, double *out) {
+    if (ctx == nullptr) return 0;
+    // 支持的年份内，NaN也在此拒绝
+    const double first = (double)astronomy::julian_day_from_civil(calendar::MIN_LUNAR_YEAR, 1, 1, 0, 0, 0.0);
+    const double last = (double)astronomy::julian_day_from_civil(calendar::MAX_LUNAR_YEAR, 12, 1, 0, 0, 0.0);
+    size_t ok = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = 0;
+        if (!(jd_ut[i] >= first && jd_ut[i] < last)) continue;
+
+        const astronomy::REAL tt = jd_ut[i] + astronomy::calc_delta_t(jd_ut[i]);
+        calendar::event_stream stream(tt, calendar::EVENTS_NEW_MOONS);
+        const astronomy::REAL jd = stream.next().jd;
+        out[i] = (double)(jd - astronomy::calc_delta_t(jd));
+        ++ok;
+    }
+    return ok;
+}
+
+// 四柱只取决于节气，与精度档无关
+CHNCAL_API size_t chncal_four_pillars(chncal_context *ctx, const chncal_datetime *in, size_t n, chncal_pillars *out) {
+    if (ctx == nullptr) return 0;
+    size_t ok = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const chncal_datetime &dt = in[i];
+        out[i] = chncal_pillars{ 0, 0, 0, 0 };
+        if (!valid_date(dt.year, dt.month, dt.day)) continue;
+
+        const astronomy::REAL local = astronomy::julian_day_from_civil(dt.year, dt.month, dt.day, dt.hour, dt.minute, dt.second);
+        const calendar::four_pillars_t fp = calendar::calc_four_pillars(ctx->ctx, local);
+        out[i] = chncal_pillars{ fp.year, fp.month, fp.day, fp.hour };
+        ++ok;
+    }
+    return ok;
+}
+
+}
@@ -0,0 +1,115 @@
+﻿#ifndef _CHNCAL_H_
+#define _CHNCAL_H_
+
+/*
+ * 农历计算的C接口，供其他语言经FFI调用，实现在chncal.cpp，编译为动态库：
+ *   g++ -std=c++14 -O2 -shared -fPIC -fvisibility=hidden -o libchncal.so chncal.cpp -lquadmath
+ *
+ * 各函数按数组批量处理，结果写入调用者提供的数组，计算过程中不分配内存
+ * 上下文不是线程安全的，每个线程使用自己的上下文；不同上下文之间互不影响
+ * 公历日期1582-10-15之前为儒略历，年份无0年，公元前1年为-1；农历年为天文纪年
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(CHNCAL_BUILD)
+#define CHNCAL_API __declspec(dllexport)
+#else
+#define CHNCAL_API __declspec(dllimport)
+#endif
+#else
+#define CHNCAL_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 接口有不兼容的改动时加1 */
+#define CHNCAL_ABI_VERSION 1
+
+/* 支持的年份（公历年与农历年），与calendar::MIN_LUNAR_YEAR、MAX_LUNAR_YEAR相同，超出时该项失败 */
+#define CHNCAL_MIN_YEAR (-4000)
+#define CHNCAL_MAX_YEAR 5999
+
+typedef struct chncal_context chncal_context;
+
+/* 精度档，与calendar::calc_mode_t相同 */
+enum {
+    CHNCAL_MODE_FULL = 0,
+    CHNCAL_MODE_ADAPTIVE = 1,
+    CHNCAL_MODE_CERTIFIED = 2
+};
+
+/* 时区规则 */
+enum {
+    CHNCAL_TZ_CHINA = 0,
+    CHNCAL_TZ_VIETNAM = 1,
+    CHNCAL_TZ_KOREA = 2
+};
+
+typedef struct {
+    int year;
+    int month;
+    int day;
+} chncal_date;
+
+typedef struct {
+    int year;
+    int month;
+    int day;
+    int hour;
+    int minute;
+    double second;
+} chncal_datetime;
+
+typedef struct {
+    int year;
+    int month;  /* 1~12 */
+    int leap;   /* 闰月为1 */
+    int day;    /* 1~30 */
+} chncal_lunar_date;
+
+/* 干支序号，0为甲子 */
+typedef struct {
+    int year;
+    int month;
+    int day;
+    int hour;
+} chncal_pillars;
+
+CHNCAL_API int chncal_abi_version(void);
+
+/* mode或timezone无效、内存不足时返回NULL */
+CHNCAL_API chncal_context *chncal_context_create(int mode, int timezone);
+
+/* 固定时区，hours为UTC+hours */
+CHNCAL_API chncal_context *chncal_context_create_fixed(int mode, double hours);
+
+CHNCAL_API void chncal_context_destroy(chncal_context *ctx);
+
+/*
+ * 以下函数返回成功的个数；失败的项（日期无效、农历无此日、年份超出CHNCAL_MIN_YEAR ~ CHNCAL_MAX_YEAR）输出全为0
+ */
+
+/* 公历转农历 */
+CHNCAL_API size_t chncal_gregorian_to_lunar(chncal_context *ctx, const chncal_date *in, size_t n, chncal_lunar_date *out);
+
+/* 农历转公历 */
+CHNCAL_API size_t chncal_lunar_to_gregorian(chncal_context *ctx, const chncal_lunar_date *in, size_t n, chncal_date *out);
+
+/* 公历年的24节气，out[i * 24 + k]为years[i]年第k个节气（0小寒 ~ 23冬至）的世界时儒略日，全精度 */
+CHNCAL_API size_t chncal_solar_terms(chncal_context *ctx, const int *years, size_t n, double *out);
+
+/* 不早于jd_ut[i]的第一个朔，世界时儒略日，全精度 */
+CHNCAL_API size_t chncal_new_moons_after(chncal_context *ctx, const double *jd_ut, size_t n, double *out);
+
+/* 四柱，时间为上下文时区的当地时间 */
+CHNCAL_API size_t chncal_four_pillars(chncal_context *ctx, const chncal_datetime *in, size_t n, chncal_pillars *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
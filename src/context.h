@@ -0,0 +1,138 @@
+﻿#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include "calendar.h"
+#include "four_pillars.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace calendar {
+    // 计算上下文：精度档、时区规则，以及只属于它的缓存与临时缓冲
+    // 上下文之间不共享可变状态，每个线程用自己的上下文即可并行，无需加锁；同一个上下文不能被多个线程同时使用
+    // 农历年缓存按年直接映射，year_slots个槽在构造时分配，之后查询不再分配内存；相距不足year_slots年的年份不会互相挤出
+    // 逐年顺序查询时相邻两年共用一个事件流（lunar_year_solver），重叠的节气与朔不再重解
+    class calendar_context {
+    public:
+        explicit calendar_context(calc_mode_t mode = CALC_ADAPTIVE, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA, int year_slots = 256)
+            : _mode(mode), _rule(rule), _slot_year(year_slots), _slot_valid(year_slots, 0), _years(year_slots), _solver(mode) {
+        }
+
+        calc_mode_t mode() const { return _mode; }
+        const timezone_rule_t &rule() const { return _rule; }
+
+        // 改变精度档或时区后，已缓存的结果作废
+        void set_mode(calc_mode_t mode) {
+            _mode = mode;
+            _solver = lunar_year_solver(mode);
+            clear();
+        }
+
+        void set_rule(const timezone_rule_t &rule) {
+            _rule = rule;
+            clear();
+        }
+
+        void clear() {
+            _slot_valid.assign(_slot_valid.size(), 0);
+            _pillar_loaded = false;
+            _solver.reset();
+        }
+
+        const lunar_year_t &lunar_year(int y) {
+            const std::size_t i = (unsigned)y % _years.size();
+            if (!_slot_valid[i] || _slot_year[i] != y) {
+                const astronomy::REAL tz = timezone_offset(_rule, y);
+                lunar_year_events_t ev;
+                _solver.solve(y, &tz, 1, ev);
+                bin_lunar_year(ev, tz, _years[i]);
+                _slot_year[i] = y;
+                _slot_valid[i] = 1;
+            }
+            return _years[i];
+        }
+
+        // 同lunar_year，供query.h等按年取农历年的模板使用
+        const lunar_year_t &get(int y) { return lunar_year(y); }
+
+        const lunar_year_t &lunar_year_containing(astronomy::day_number_t day) {
+            int y, m, d;
+            astronomy::civil_from_day_number(day, &y, &m, &d);
+            y += (y < 0);
+            const lunar_year_t *ly = &lunar_year(y);
+            while (day < ly->months[0].first_day) ly = &lunar_year(ly->year - 1);
+            while (day >= ly->end_day) ly = &lunar_year(ly->year + 1);
+            return *ly;
+        }
+
+        // 包含地方时local的节气年，只保留最近用到的一个
+        const pillar_year_t &pillar_year_containing(astronomy::REAL local) {
+            seek_pillar_year(local, _pillar, _pillar_loaded, _rule);
+            return _pillar;
+        }
+
+        // 批量计算时排序用的下标，容量只增不减
+        std::vector<std::uint32_t> &order_scratch() { return _order; }
+
+    private:
+        calc_mode_t _mode;
+        timezone_rule_t _rule;
+        std::vector<int> _slot_year;
+        std::vector<char> _slot_valid;
+        std::vector<lunar_year_t> _years;
+        lunar_year_solver _solver;
+        pillar_year_t _pillar;
+        bool _pillar_loaded = false;
+        std::vector<std::uint32_t> _order;
+    };
+
+    // 本线程的默认上下文，自适应档，中国时区；按需改用set_mode、set_rule
+    static inline calendar_context &default_context() {
+        static thread_local calendar_context ctx;
+        return ctx;
+    }
+
+    // 以下为接受上下文的入口，精度档与时区取自上下文，结果在上下文中缓存
+
+    // 返回的引用在下一次用同一上下文查询前有效
+    static inline const lunar_year_t &calc_lunar_year(calendar_context &ctx, int y) {
+        return ctx.lunar_year(y);
+    }
+
+    // lunar_year_containing总能找到所在的农历年，返回值只是沿用按年查询的接口
+    static inline bool lunar_date_from_day(calendar_context &ctx, astronomy::day_number_t day, lunar_date_t &ld) {
+        return lunar_date_from_day(ctx.lunar_year_containing(day), day, ld);
+    }
+
+    // 无此月或无此日时返回false
+    static inline bool day_from_lunar_date(calendar_context &ctx, const lunar_date_t &ld, astronomy::day_number_t &out) {
+        return day_from_lunar_date(ctx.lunar_year(ld.year), ld.month, ld.leap, ld.day, out);
+    }
+
+    // local为上下文时区的地方时儒略日
+    static inline four_pillars_t calc_four_pillars(calendar_context &ctx, astronomy::REAL local) {
+        return calc_four_pillars(local, ctx.pillar_year_containing(local));
+    }
+
+    // 同calc_four_pillars_bulk，排序用上下文的临时缓冲
+    static inline void calc_four_pillars_bulk(calendar_context &ctx, const astronomy::REAL *local, std::size_t n, four_pillars_t *out) {
+        std::vector<std::uint32_t> &order = ctx.order_scratch();
+        order.resize(n);
+        for (std::size_t i = 0; i < n; ++i) order[i] = (std::uint32_t)i;
+        std::sort(order.begin(), order.end(), [local](std::uint32_t a, std::uint32_t b) { return local[a] < local[b]; });
+        for (std::uint32_t i : order) {
+            out[i] = calc_four_pillars(ctx, local[i]);
+        }
+    }
+
+    // 逐日区间，ctx须在区间的生存期内有效
+    static inline day_range calc_days(const calendar_context &ctx, astronomy::day_number_t first, astronomy::day_number_t last) {
+        return day_range(first, last, ctx.mode(), ctx.rule());
+    }
+
+    static inline event_stream make_event_stream(const calendar_context &ctx, astronomy::REAL start, int kinds = EVENTS_ALL, bool forward = true) {
+        return event_stream(start, kinds, forward, ctx.mode());
+    }
+}
+
+#endif
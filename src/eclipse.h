@@ -0,0 +1,113 @@
+﻿#ifndef _ECLIPSE_H_
+#define _ECLIPSE_H_
+
+#include "calendar.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace calendar {
+    // 食季筛选：列出月球在交点附近的朔（可能的日食）与望（可能的月食）
+    // 只是候选，不判断食是否真的发生及食分，超出食限的朔望必无食
+    // 逐个朔望（朔望月序号k，k为整数为朔，k + 0.5为望）：
+    //   1. 由平朔望与平升交角距F先筛，|sin F|超过MEAN_SCREEN_LIMIT的直接跳过，约四分之三的朔望不必求解
+    //   2. 余下的用低精度档求出朔望时刻（与calc_new_moon_nearby同一套迭代），再用全部黄纬项求月球黄纬
+    // 朔望月按块分给各线程，结果按时间顺序拼接，与线程数无关
+    namespace eclipse {
+        // 平朔望筛选的阈值：平升交角距离交点约21度以内（Meeus的|sin F| < 0.36），另留余量
+        static constexpr double MEAN_SCREEN_LIMIT = 0.40;
+
+        // 宽松的食限（月球黄纬，度），超出者必无食
+        static constexpr double SOLAR_LATITUDE_LIMIT = 1.59;  // 日偏食
+        static constexpr double LUNAR_LATITUDE_LIMIT = 1.66;  // 半影月食
+
+        static constexpr double SYNODIC_MONTH = 29.530588861;
+
+        struct candidate_t {
+            astronomy::REAL jd;  // 朔望时刻，力学时儒略日
+            bool solar;  // true为朔（日食候选），false为望（月食候选）
+            double latitude;  // 月球黄纬，度
+            double node_distance;  // 月球到最近交点的平升交角距，-90 ~ 90度，正为过交点之后
+        };
+
+        namespace detail {
+            // 第k个平朔望（k = 0为2000-01-06的朔）的力学时与平升交角距F（度），Meeus第49章
+            static void mean_syzygy(double k, astronomy::REAL &jd, double &F) {
+                const double T = k / 1236.85;
+                jd = 2451550.09766L + (astronomy::REAL)SYNODIC_MONTH * k + (0.00015437 + (-0.000000150 + 0.00000000073 * T) * T) * T * T;
+                F = 160.7108 + 390.67050284 * k + (-0.0016118 + (-0.00000227 + 0.000000011 * T) * T) * T * T;
+            }
+
+            // 到最近交点的角距，F归到[-90, 90)
+            static double node_distance(double F) {
+                return F - 180 * std::floor(F / 180 + 0.5);
+            }
+
+            // 朔望月k0 ~ k1 - 1，筛出候选追加到out，jd_first ~ jd_last之外的不要
+            static void screen_block(long long k0, long long k1, astronomy::REAL jd_first, astronomy::REAL jd_last, std::vector<candidate_t> &out) {
+                for (long long k = k0; k < k1; ++k) {
+                    for (int half = 0; half < 2; ++half) {
+                        astronomy::REAL jd;
+                        double F;
+                        mean_syzygy(k + half * 0.5, jd, F);
+                        if (std::fabs(std::sin(F * M_PI / 180)) > MEAN_SCREEN_LIMIT) continue;
+
+                        const event_estimate_t e = calc_moon_phase_nearby_lite(jd, half * 180);
+                        if (e.jd < jd_first || e.jd >= jd_last) continue;
+
+                        candidate_t c;
+                        c.jd = e.jd;
+                        c.solar = half == 0;
+                        c.latitude = (double)astronomy::get_moon_ecliptic_latitude(e.jd);
+                        c.node_distance = node_distance(F);
+                        if (std::fabs(c.latitude) <= (c.solar ? SOLAR_LATITUDE_LIMIT : LUNAR_LATITUDE_LIMIT)) out.push_back(c);
+                    }
+                }
+            }
+        }
+
+        // 力学时儒略日[jd_first, jd_last)内的全部候选，按时间顺序
+        // threads个线程按块（每块lunations_per_block个朔望月）取任务
+        static std::vector<candidate_t> screen(astronomy::REAL jd_first, astronomy::REAL jd_last, int threads = 1, int lunations_per_block = 256) {
+            std::vector<candidate_t> result;
+            if (!(jd_first < jd_last)) return result;
+
+            // 平朔望与真朔望相差不到一日，前后各多取一个朔望月
+            const long long k0 = (long long)std::floor((double)(jd_first - 2451550.09766L) / SYNODIC_MONTH) - 1;
+            const long long k1 = (long long)std::ceil((double)(jd_last - 2451550.09766L) / SYNODIC_MONTH) + 1;
+            const long long per_block = std::max(1, lunations_per_block);
+            const long long block_count = (k1 - k0 + per_block - 1) / per_block;
+            std::vector<std::vector<candidate_t>> blocks((std::size_t)block_count);
+
+            std::atomic<long long> next(0);
+            auto work = [&]() {
+                for (long long b; (b = next++) < block_count;) {
+                    const long long a = k0 + b * per_block;
+                    detail::screen_block(a, std::min(k1, a + per_block), jd_first, jd_last, blocks[(std::size_t)b]);
+                }
+            };
+
+            const int n = (int)std::max(1LL, std::min<long long>(threads, block_count));
+            std::vector<std::thread> workers;
+            for (int t = 1; t < n; ++t) workers.emplace_back(work);
+            work();
+            for (auto &w : workers) w.join();
+
+            std::size_t total = 0;
+            for (const auto &b : blocks) total += b.size();
+            result.reserve(total);
+            for (const auto &b : blocks) result.insert(result.end(), b.begin(), b.end());
+            return result;
+        }
+
+        // 外推公历first_year ~ last_year年（天文纪年，力学时）
+        static std::vector<candidate_t> screen_years(int first_year, int last_year, int threads = 1) {
+            return screen(astronomy::make_julian_day(first_year, 1, 1, 0, 0, 0), astronomy::make_julian_day(last_year + 1, 1, 1, 0, 0, 0), threads);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,353 @@
+﻿#ifndef _EVENT_DB_H_
+#define _EVENT_DB_H_
+
+#include "calendar.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace calendar {
+    // 预先计算的天象事件库
+    // 文件布局：header_t、年索引（year_count + 1个year_entry_t，最后一个为哨兵）、事件（event_count个record_t）
+    // 均按本机字节序写入，byte_order用于识别字节序不符的文件
+    // 事件按力学时以秒存储，舍入误差不超过0.5秒，归日时按误差区间判断，跨越日界的仍由全精度重解
+    namespace event_db {
+        static constexpr char MAGIC[8] = { 'C', 'H', 'N', 'C', 'A', 'L', 'E', 'V' };
+        static constexpr std::uint32_t VERSION = 1;
+        static constexpr std::uint32_t ENDIAN_CHECK = 0x01020304;
+
+        // 秒的舍入误差，加上全精度解本身的误差，单位日
+        static constexpr astronomy::REAL QUANTIZATION_ERROR = 1.0 / 86400.0;
+
+        struct header_t {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            std::uint32_t header_size;
+            std::int32_t first_year;  // 公历年（天文纪年），按力学时划分
+            std::int32_t last_year;  // 含
+            std::uint32_t kinds;  // EVENTS_*
+            std::uint32_t event_count;
+            std::uint32_t reserved;
+            std::uint64_t checksum;  // FNV-1a 64，覆盖年索引与事件
+        };
+
+        struct year_entry_t {
+            std::int32_t base_day;  // 该年1月1日的日序，事件的秒数从该日0时（力学时）起算
+            std::uint32_t first;  // 该年第一个事件的下标
+        };
+
+        struct record_t {
+            std::int32_t seconds;
+            std::uint8_t type;  // event_type_t
+            std::uint8_t index;  // 节气0小寒 ~ 23冬至；月相0朔 1上弦 2望 3下弦
+            std::uint16_t reserved;
+        };
+
+        static std::uint64_t fnv1a(const void *data, std::size_t size, std::uint64_t h = 14695981039346656037ULL) {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+            for (std::size_t i = 0; i < size; ++i) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        static int event_angle(int type, int index) {
+            return type == EVENT_SOLAR_TERM ? (index + 19) % 24 * 15 : index * 90;
+        }
+
+        static astronomy::day_number_t year_base_day(int year) {
+            return astronomy::day_number_from_gregorian(year, 1, 1);
+        }
+
+        // 生成[first_year, last_year]的事件库，先写临时文件再改名，失败时返回false
+        static bool generate(const char *path, int first_year, int last_year, int kinds = EVENTS_ALL) {
+            if (last_year < first_year) return false;
+
+            const int year_count = last_year - first_year + 1;
+            std::string years_buf((year_count + 1) * sizeof(year_entry_t), '\0');
+            std::string records_buf;
+            year_entry_t *years = reinterpret_cast<year_entry_t *>(&years_buf[0]);
+
+            event_stream stream(year_base_day(first_year) - 0.5, kinds);
+            std::uint32_t count = 0;
+            for (int k = 0; k <= year_count; ++k) {
+                years[k].base_day = year_base_day(first_year + k);
+                years[k].first = count;
+                if (k == year_count) break;
+
+                const astronomy::REAL base = years[k].base_day - 0.5;
+                const astronomy::REAL end = year_base_day(first_year + k + 1) - 0.5;
+                while (stream.peek().jd < end) {
+                    const astro_event_t e = stream.next();
+                    record_t r{};
+                    r.seconds = (std::int32_t)std::llround((double)((e.jd - base) * 86400));
+                    r.type = (std::uint8_t)e.type;
+                    r.index = (std::uint8_t)e.index;
+                    records_buf.append(reinterpret_cast<const char *>(&r), sizeof(r));
+                    ++count;
+                }
+            }
+
+            header_t h{};
+            std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+            h.version = VERSION;
+            h.byte_order = ENDIAN_CHECK;
+            h.header_size = sizeof(header_t);
+            h.first_year = first_year;
+            h.last_year = last_year;
+            h.kinds = (std::uint32_t)kinds;
+            h.event_count = count;
+            h.checksum = fnv1a(records_buf.data(), records_buf.size(), fnv1a(years_buf.data(), years_buf.size()));
+
+            const std::string tmp = std::string(path) + ".tmp";
+            FILE *fp = fopen(tmp.c_str(), "wb");
+            if (fp == nullptr) return false;
+            bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+                && fwrite(years_buf.data(), 1, years_buf.size(), fp) == years_buf.size()
+                && fwrite(records_buf.data(), 1, records_buf.size(), fp) == records_buf.size();
+            ok = (fclose(fp) == 0) && ok;
+            if (!ok) {
+                remove(tmp.c_str());
+                return false;
+            }
+#ifdef _WIN32
+            return MoveFileExA(tmp.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+            return rename(tmp.c_str(), path) == 0;
+#endif
+        }
+
+        // 只读映射的事件库，不在覆盖范围内的查询改为实时计算
+        class database {
+        public:
+            database() = default;
+            database(const database &) = delete;
+            database &operator=(const database &) = delete;
+            ~database() { close(); }
+
+            // verify为true时校验全部内容，否则只校验文件头与长度
+            bool open(const char *path, bool verify = true) {
+                close();
+                if (!map(path)) return false;
+
+                if (_size < sizeof(header_t)) return fail();
+                _header = static_cast<const header_t *>(_data);
+                if (std::memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0 || _header->version != VERSION
+                    || _header->byte_order != ENDIAN_CHECK || _header->header_size != sizeof(header_t)
+                    || _header->last_year < _header->first_year) {
+                    return fail();
+                }
+
+                const std::size_t year_bytes = (std::size_t)(_header->last_year - _header->first_year + 2) * sizeof(year_entry_t);
+                const std::size_t record_bytes = (std::size_t)_header->event_count * sizeof(record_t);
+                if (_size != sizeof(header_t) + year_bytes + record_bytes) return fail();
+
+                const char *p = static_cast<const char *>(_data) + sizeof(header_t);
+                _years = reinterpret_cast<const year_entry_t *>(p);
+                _records = reinterpret_cast<const record_t *>(p + year_bytes);
+                if (verify && fnv1a(_records, record_bytes, fnv1a(_years, year_bytes)) != _header->checksum) {
+                    return fail();
+                }
+                return true;
+            }
+
+            void close() {
+                unmap();
+                _header = nullptr;
+                _years = nullptr;
+                _records = nullptr;
+            }
+
+            bool is_open() const { return _header != nullptr; }
+
+            // 覆盖的力学时区间[begin, end)
+            astronomy::REAL begin() const { return _years[0].base_day - 0.5; }
+            astronomy::REAL end() const { return _years[year_count()].base_day - 0.5; }
+
+            // 按时间顺序访问[jd_begin, jd_end)内的事件，超出覆盖范围的部分实时计算
+            template <class Visitor>
+            void events(astronomy::REAL jd_begin, astronomy::REAL jd_end, int kinds, Visitor &&visitor) const {
+                if (jd_begin >= jd_end) return;
+
+                auto live = [kinds, &visitor](astronomy::REAL b, astronomy::REAL e) {
+                    event_stream stream(b, kinds);
+                    while (stream.peek().jd < e) visitor(stream.next());
+                };
+
+                const astronomy::REAL db_begin = is_open() ? (jd_begin > begin() ? jd_begin : begin()) : jd_end;
+                const astronomy::REAL db_end = is_open() ? (jd_end < end() ? jd_end : end()) : jd_end;
+                if (!is_open() || (kinds & ~(int)_header->kinds) != 0 || db_begin >= db_end) {
+                    live(jd_begin, jd_end);
+                    return;
+                }
+
+                // 覆盖范围之前、之内、之后
+                if (jd_begin < db_begin) live(jd_begin, db_begin);
+                cursor c(*this, db_begin, kinds);
+                while (!c.done() && c.peek().jd < db_end) visitor(c.next());
+                if (db_end < jd_end) live(db_end, jd_end);
+            }
+
+            // 农历年，所需事件都在库中时不再求解，否则实时计算
+            // mode为CALC_FULL时按CALC_ADAPTIVE处理：只有秒的舍入使其跨越日界的事件才重解，排出的日期相同
+            void lunar_year(int y, lunar_year_t &ly, calc_mode_t mode = CALC_FULL, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) const {
+                const int needed = EVENTS_SOLAR_TERMS | EVENTS_NEW_MOONS;
+                if (!is_open() || (needed & ~(int)_header->kinds) != 0 || y - 1 < _header->first_year || y + 2 > _header->last_year) {
+                    calc_lunar_year(y, ly, mode, rule);
+                    return;
+                }
+
+                const astronomy::REAL tz = timezone_offset(rule, y);
+                lunar_year_events_t ev;
+                cursor c(*this, lunar_year_events_start(y), needed);
+                collect_lunar_year_events(y, c, &tz, 1, mode == CALC_FULL ? CALC_ADAPTIVE : mode, ev);
+                bin_lunar_year(ev, tz, ly);
+            }
+
+        private:
+            // 按时间顺序读取库中的事件，与event_stream接口相同
+            class cursor {
+            public:
+                cursor(const database &db, astronomy::REAL start, int kinds) : _db(db), _kinds(kinds) {
+                    // 先按年定位，再在年内二分
+                    const int n = db.year_count();
+                    int lo = 0, hi = n;
+                    while (lo + 1 < hi) {
+                        const int mid = (lo + hi) / 2;
+                        if (db._years[mid].base_day - 0.5 <= start) lo = mid;
+                        else hi = mid;
+                    }
+                    _year = lo;
+
+                    const astronomy::REAL base = db._years[lo].base_day - 0.5;
+                    const double seconds = (double)((start - base) * 86400);
+                    std::uint32_t a = db._years[lo].first, b = db._years[lo + 1].first;
+                    while (a < b) {
+                        const std::uint32_t mid = (a + b) / 2;
+                        if (db._records[mid].seconds < seconds) a = mid + 1;
+                        else b = mid;
+                    }
+                    _pos = a;
+                    skip();
+                }
+
+                bool done() const { return _pos >= _db._header->event_count; }
+
+                const astro_event_t &peek() const { return _event; }
+
+                astro_event_t next() {
+                    const astro_event_t e = _event;
+                    ++_pos;
+                    skip();
+                    return e;
+                }
+
+            private:
+                // 跳过不需要的事件，并解码当前事件
+                void skip() {
+                    for (; !done(); ++_pos) {
+                        const record_t &r = _db._records[_pos];
+                        const int kind = r.type == EVENT_SOLAR_TERM ? EVENTS_SOLAR_TERMS : (r.index == 0 ? EVENTS_NEW_MOONS : EVENTS_MOON_QUARTERS);
+                        if (kind & _kinds) break;
+                    }
+                    if (done()) return;
+
+                    while (_db._years[_year + 1].first <= _pos) ++_year;
+                    const record_t &r = _db._records[_pos];
+                    _event.jd = _db._years[_year].base_day - 0.5 + r.seconds / (astronomy::REAL)86400;
+                    _event.err = QUANTIZATION_ERROR;
+                    _event.type = (event_type_t)r.type;
+                    _event.index = r.index;
+                    _event.angle = event_angle(r.type, r.index);
+                }
+
+                const database &_db;
+                int _kinds;
+                int _year = 0;
+                std::uint32_t _pos = 0;
+                astro_event_t _event{};
+            };
+
+            int year_count() const { return _header->last_year - _header->first_year + 1; }
+
+            bool fail() {
+                close();
+                return false;
+            }
+
+#ifdef _WIN32
+            bool map(const char *path) {
+                _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (_file == INVALID_HANDLE_VALUE) return false;
+                LARGE_INTEGER size;
+                if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) return fail();
+                _size = (std::size_t)size.QuadPart;
+                _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (_mapping == nullptr) return fail();
+                _data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+                return _data != nullptr || fail();
+            }
+
+            void unmap() {
+                if (_data != nullptr) UnmapViewOfFile(_data);
+                if (_mapping != nullptr) CloseHandle(_mapping);
+                if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+                _data = nullptr;
+                _mapping = nullptr;
+                _file = INVALID_HANDLE_VALUE;
+                _size = 0;
+            }
+
+            HANDLE _file = INVALID_HANDLE_VALUE;
+            HANDLE _mapping = nullptr;
+#else
+            bool map(const char *path) {
+                const int fd = ::open(path, O_RDONLY);
+                if (fd < 0) return false;
+                struct stat st;
+                if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                    ::close(fd);
+                    return false;
+                }
+                _size = (std::size_t)st.st_size;
+                void *p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (p == MAP_FAILED) {
+                    _size = 0;
+                    return false;
+                }
+                _data = p;
+                return true;
+            }
+
+            void unmap() {
+                if (_data != nullptr) munmap(const_cast<void *>(_data), _size);
+                _data = nullptr;
+                _size = 0;
+            }
+#endif
+
+            const void *_data = nullptr;
+            std::size_t _size = 0;
+            const header_t *_header = nullptr;
+            const year_entry_t *_years = nullptr;
+            const record_t *_records = nullptr;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+﻿#ifndef _FESTIVALS_H_
+#define _FESTIVALS_H_
+
+#include "calendar.h"
+#include "context.h"
+
+#include <climits>
+#include <cstring>
+
+namespace calendar {
+    // 传统节日与时令，均按农历年归属：某年的节日为该农历年内的那一天
+    // 冬至定在十一月，清明、夏至、立秋也都在同一农历年内，故一个lunar_year_t即可得出全部节日
+    enum festival_t {
+        FESTIVAL_SPRING,  // 春節，正月初一
+        FESTIVAL_LANTERN,  // 元宵，正月十五
+        FESTIVAL_QINGMING,  // 清明，节气所在日
+        FESTIVAL_DRAGON_BOAT,  // 端午，五月初五
+        FESTIVAL_QIXI,  // 七夕，七月初七
+        FESTIVAL_MID_AUTUMN,  // 中秋，八月十五
+        FESTIVAL_DOUBLE_NINTH,  // 重陽，九月初九
+        FESTIVAL_WINTER_SOLSTICE,  // 冬至，节气所在日
+        FESTIVAL_CHUFU,  // 初伏，夏至起第三个庚日
+        FESTIVAL_ZHONGFU,  // 中伏，夏至起第四个庚日
+        FESTIVAL_MOFU,  // 末伏，立秋起第一个庚日
+        FESTIVAL_SANFU_END,  // 出伏，末伏后十日
+        FESTIVAL_SHUJIU,  // 一九，冬至日起，每九日为一九
+        FESTIVAL_SHUJIU_END,  // 出九，冬至起第八十一日之后
+        FESTIVAL_COUNT
+    };
+
+    static constexpr const char *festival_names[FESTIVAL_COUNT] = {
+        "春節", "元宵", "清明", "端午", "七夕", "中秋", "重陽", "冬至", "初伏", "中伏", "末伏", "出伏", "一九", "出九"
+    };
+
+    // 命令行、查询用的拉丁字母名
+    static constexpr const char *festival_keys[FESTIVAL_COUNT] = {
+        "spring", "lantern", "qingming", "dragon-boat", "qixi", "mid-autumn", "double-ninth", "winter-solstice",
+        "chufu", "zhongfu", "mofu", "sanfu-end", "shujiu", "shujiu-end"
+    };
+
+    // 按名字（汉字或拉丁字母）查节日，没有时返回-1
+    static int find_festival(const char *name) {
+        for (int i = 0; i < FESTIVAL_COUNT; ++i) {
+            if (strcmp(name, festival_names[i]) == 0 || strcmp(name, festival_keys[i]) == 0) return i;
+        }
+        return -1;
+    }
+
+    // 一年的全部节日，无法确定的为INT_MIN（例如该年缺少所需节气）
+    struct festival_year_t {
+        int year;
+        astronomy::day_number_t days[FESTIVAL_COUNT];
+    };
+
+    namespace detail {
+        static astronomy::day_number_t term_day(const lunar_year_t &ly, int index) {
+            for (int i = 0; i < ly.term_count; ++i) {
+                if (ly.terms[i].index == index) return ly.terms[i].day;
+            }
+            return INT_MIN;
+        }
+
+        // 非闰月的某日
+        static astronomy::day_number_t lunar_day(const lunar_year_t &ly, int month, int day) {
+            astronomy::day_number_t out;
+            return day_from_lunar_date(ly, month, false, day, out) ? out : INT_MIN;
+        }
+
+        // 不早于day的第一个庚日
+        static astronomy::day_number_t next_geng_day(astronomy::day_number_t day) {
+            return day + (16 - astronomy::sexagenary_day(day) % 10) % 10;
+        }
+    }
+
+    // 由一个农历年得出全部节日，不再求解任何节气或朔
+    static void calc_festivals(const lunar_year_t &ly, festival_year_t &fy) {
+        astronomy::day_number_t *d = fy.days;
+        fy.year = ly.year;
+
+        d[FESTIVAL_SPRING] = ly.months[0].first_day;
+        d[FESTIVAL_LANTERN] = detail::lunar_day(ly, 1, 15);
+        d[FESTIVAL_QINGMING] = detail::term_day(ly, 6);
+        d[FESTIVAL_DRAGON_BOAT] = detail::lunar_day(ly, 5, 5);
+        d[FESTIVAL_QIXI] = detail::lunar_day(ly, 7, 7);
+        d[FESTIVAL_MID_AUTUMN] = detail::lunar_day(ly, 8, 15);
+        d[FESTIVAL_DOUBLE_NINTH] = detail::lunar_day(ly, 9, 9);
+        d[FESTIVAL_WINTER_SOLSTICE] = detail::term_day(ly, 23);
+
+        // 三伏：夏至当日若为庚日即算第一个庚日
+        const astronomy::day_number_t summer = detail::term_day(ly, 11);
+        const astronomy::day_number_t autumn = detail::term_day(ly, 14);
+        if (summer != INT_MIN && autumn != INT_MIN) {
+            d[FESTIVAL_CHUFU] = detail::next_geng_day(summer) + 20;
+            d[FESTIVAL_ZHONGFU] = d[FESTIVAL_CHUFU] + 10;
+            d[FESTIVAL_MOFU] = detail::next_geng_day(autumn);
+            d[FESTIVAL_SANFU_END] = d[FESTIVAL_MOFU] + 10;
+        }
+        else {
+            d[FESTIVAL_CHUFU] = d[FESTIVAL_ZHONGFU] = d[FESTIVAL_MOFU] = d[FESTIVAL_SANFU_END] = INT_MIN;
+        }
+
+        // 数九
+        const astronomy::day_number_t winter = d[FESTIVAL_WINTER_SOLSTICE];
+        d[FESTIVAL_SHUJIU] = winter;
+        d[FESTIVAL_SHUJIU_END] = winter != INT_MIN ? winter + 81 : INT_MIN;
+    }
+
+    // 某日在三伏或数九中的位置
+    // 三伏时返回1~3（初伏、中伏、末伏），数九时返回-1~-9（一九~九九），都不是时返回0；nth为该伏或该九的第几日，从1起
+    static inline int seasonal_period(const festival_year_t &fy, astronomy::day_number_t day, int *nth = nullptr) {
+        const astronomy::day_number_t *d = fy.days;
+        if (d[FESTIVAL_CHUFU] != INT_MIN && day >= d[FESTIVAL_CHUFU] && day < d[FESTIVAL_SANFU_END]) {
+            const int k = day < d[FESTIVAL_ZHONGFU] ? 0 : day < d[FESTIVAL_MOFU] ? 1 : 2;
+            if (nth) *nth = day - d[FESTIVAL_CHUFU + k] + 1;
+            return k + 1;
+        }
+        if (d[FESTIVAL_SHUJIU] != INT_MIN && day >= d[FESTIVAL_SHUJIU] && day < d[FESTIVAL_SHUJIU_END]) {
+            const int n = day - d[FESTIVAL_SHUJIU];
+            if (nth) *nth = n % 9 + 1;
+            return -(n / 9 + 1);
+        }
+        return 0;
+    }
+
+    // [first_year, last_year]各年的全部节日，每年只取一次农历年（在ctx中缓存），visitor(const festival_year_t &)
+    template <class Visitor>
+    static void calc_festivals_range(calendar_context &ctx, int first_year, int last_year, Visitor &&visitor) {
+        festival_year_t fy;
+        for (int y = first_year; y <= last_year; ++y) {
+            calc_festivals(ctx.lunar_year(y), fy);
+            visitor(static_cast<const festival_year_t &>(fy));
+        }
+    }
+
+    // 某个节日在[first_year, last_year]各年的日子，out须有last_year - first_year + 1项
+    static inline void calc_festival_range(calendar_context &ctx, festival_t f, int first_year, int last_year, astronomy::day_number_t *out) {
+        calc_festivals_range(ctx, first_year, last_year, [&](const festival_year_t &fy) {
+            out[fy.year - first_year] = fy.days[f];
+        });
+    }
+}
+
+#endif
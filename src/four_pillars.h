@@ -0,0 +1,123 @@
+﻿#ifndef _FOUR_PILLARS_H_
+#define _FOUR_PILLARS_H_
+
+#include "calendar.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace calendar {
+    // 四柱，均为干支序号，0为甲子
+    struct four_pillars_t {
+        int year;
+        int month;
+        int day;
+        int hour;
+    };
+
+    // 一个节气年（立春至次年立春）的月柱分界，地方时
+    // boundaries[0]为立春（寅月），之后依次为驚蟄、清明……大雪、次年小寒（丑月），boundaries[12]为次年立春
+    struct pillar_year_t {
+        int year;
+        astronomy::REAL boundaries[13];
+    };
+
+    // 由天干、地支求干支序号
+    static int sexagenary_from_stem_branch(int stem, int branch) {
+        return ((stem * 6 - branch * 5) % 60 + 60) % 60;
+    }
+
+    static astronomy::REAL calc_solar_term_local(int year, int idx, const timezone_rule_t &rule) {
+        const astronomy::REAL tz = timezone_offset(rule, year);
+        astronomy::REAL jd = calc_solar_term(year, idx) + tz;
+        return jd - astronomy::calc_delta_t(jd);
+    }
+
+    // start为已知的本年立春
+    static void calc_pillar_year_from(int y, astronomy::REAL start, pillar_year_t &py, const timezone_rule_t &rule) {
+        // 立春、驚蟄、清明、立夏、芒種、小暑、立秋、白露、寒露、立冬、大雪
+        py.year = y;
+        py.boundaries[0] = start;
+        for (int k = 1; k < 11; ++k) {
+            py.boundaries[k] = calc_solar_term_local(y, (21 + k * 2) % 24, rule);
+        }
+        // 次年小寒、立春
+        py.boundaries[11] = calc_solar_term_local(y + 1, 19, rule);
+        py.boundaries[12] = calc_solar_term_local(y + 1, 21, rule);
+    }
+
+    static void calc_pillar_year(int y, pillar_year_t &py, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+        calc_pillar_year_from(y, calc_solar_term_local(y, 21, rule), py, rule);
+    }
+
+    // 进入相邻的下一年时，本年的次年立春即下一年的立春，少解一次
+    static void calc_next_pillar_year(pillar_year_t &py, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+        const astronomy::REAL start = py.boundaries[12];
+        calc_pillar_year_from(py.year + 1, start, py, rule);
+    }
+
+    // 按地方时儒略日solar排日柱、时柱，年柱、月柱不变
+    // 日柱以0点为界；23点起为次日的子时，时干按次日的日干起
+    // solar可以不是排年柱、月柱所用的时刻，例如按节气的实际时刻排年、月，按真太阳时排日、时
+    static inline void set_solar_day_hour_pillars(astronomy::REAL solar, four_pillars_t &fp) {
+        const astronomy::REAL jdf = solar + 0.5;
+        const astronomy::REAL a = std::floor(jdf);
+        const astronomy::day_number_t day = (astronomy::day_number_t)a;
+        fp.day = astronomy::sexagenary_day(day);
+
+        const int hour = (int)((jdf - a) * 24);
+        const int branch = (hour + 1) / 2 % 12;
+        const int day_stem = (hour >= 23 ? astronomy::sexagenary_day(day + 1) : fp.day) % 10;
+        fp.hour = sexagenary_from_stem_branch((day_stem * 2 + branch) % 10, branch);
+    }
+
+    // local为地方时儒略日，py须包含local
+    static four_pillars_t calc_four_pillars(astronomy::REAL local, const pillar_year_t &py) {
+        four_pillars_t fp;
+
+        const int year_stem = ((py.year - 4) % 10 + 10) % 10;
+        fp.year = ((py.year - 4) % 60 + 60) % 60;
+
+        const int k = (int)(std::upper_bound(py.boundaries, py.boundaries + 12, local) - py.boundaries) - 1;
+        fp.month = sexagenary_from_stem_branch((year_stem * 2 + 2 + k) % 10, (k + 2) % 12);
+
+        set_solar_day_hour_pillars(local, fp);
+        return fp;
+    }
+
+    // 使py包含地方时t，loaded为false表示py尚未计算；t在py之后一年内时接续计算，否则按公历年重算
+    static void seek_pillar_year(astronomy::REAL t, pillar_year_t &py, bool &loaded, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+        if (loaded && t >= py.boundaries[0] && t < py.boundaries[12]) return;
+        if (loaded && t >= py.boundaries[12] && t < py.boundaries[12] + 366) {
+            calc_next_pillar_year(py, rule);
+        }
+        else {
+            int y, m, d;
+            astronomy::civil_from_day_number((astronomy::day_number_t)std::floor(t + 0.5), &y, &m, &d);
+            calc_pillar_year(y + (y < 0), py, rule);
+        }
+        while (t < py.boundaries[0]) calc_pillar_year(py.year - 1, py, rule);
+        while (t >= py.boundaries[12]) calc_next_pillar_year(py, rule);
+        loaded = true;
+    }
+
+    // 批量计算，local为rule所定时区的地方时儒略日
+    // 先按时间排序，同一节气年的时间戳共用一组月柱分界，在分界中二分查找，不再逐个求解节气
+    static inline void calc_four_pillars_bulk(const astronomy::REAL *local, std::size_t n, four_pillars_t *out, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+        if (n == 0) return;
+
+        std::vector<std::uint32_t> order(n);
+        for (std::size_t i = 0; i < n; ++i) order[i] = (std::uint32_t)i;
+        std::sort(order.begin(), order.end(), [local](std::uint32_t a, std::uint32_t b) { return local[a] < local[b]; });
+
+        pillar_year_t py;
+        bool loaded = false;
+        for (std::uint32_t i : order) {
+            seek_pillar_year(local[i], py, loaded, rule);
+            out[i] = calc_four_pillars(local[i], py);
+        }
+    }
+}
+
+#endif
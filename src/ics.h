@@ -0,0 +1,282 @@
+﻿#ifndef _ICS_H_
+#define _ICS_H_
+
+#include "calendar.h"
+#include "context.h"
+#include "festivals.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace calendar {
+    // iCalendar（RFC 5545）导出，逐年生成全天事件，边生成边写出
+    // 各事件的UID只取决于事件本身（农历日、节气所在日、节日所属年），重新导出时不变；DTSTAMP固定，相同输入的输出逐字节相同
+    // 日期为外推公历，只能表示0001~9999年
+    namespace ics {
+        enum {
+            ICS_LUNAR_DAYS = 1,  // 每日一个事件：初二、初三……，初一显示月名
+            ICS_LUNAR_MONTHS = 2,  // 每月初一一个事件，已有ICS_LUNAR_DAYS时不再单独输出
+            ICS_SOLAR_TERMS = 4,
+            ICS_FESTIVALS = 8,
+            ICS_ALL = 15
+        };
+
+        struct options_t {
+            int kinds = ICS_LUNAR_MONTHS | ICS_SOLAR_TERMS | ICS_FESTIVALS;
+            const char *name = "農曆";  // X-WR-CALNAME
+            const char *uid_domain = "chinese-calendar";  // UID的@之后部分，不同的日历应不同
+            calc_mode_t mode = CALC_ADAPTIVE;
+            timezone_rule_t rule = TIMEZONE_RULE_CHINA;
+            int threads = 1;
+            int years_per_chunk = 8;  // 并行时每块的农历年数
+        };
+
+        // TEXT值的转义：反斜杠、分号、逗号、换行
+        static void append_escaped(std::string &out, const char *text) {
+            for (const char *p = text; *p != '\0'; ++p) {
+                switch (*p) {
+                case '\\': out += "\\\\"; break;
+                case ';': out += "\\;"; break;
+                case ',': out += "\\,"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': break;
+                default: out += *p; break;
+                }
+            }
+        }
+
+        // 追加一行（含CRLF），超过75字节时折行，续行以空格开头；不在UTF-8多字节字符中间折断
+        static void append_line(std::string &out, const std::string &line) {
+            std::size_t pos = 0, limit = 75;
+            while (line.size() - pos > limit) {
+                std::size_t n = limit;
+                while (n > 0 && (line[pos + n] & 0xC0) == 0x80) --n;
+                out.append(line, pos, n);
+                out += "\r\n ";
+                pos += n;
+                limit = 74;  // 续行开头的空格占一个字节
+            }
+            out.append(line, pos, std::string::npos);
+            out += "\r\n";
+        }
+
+        static void append_header(std::string &out, const options_t &opt) {
+            std::string name = "X-WR-CALNAME:";
+            append_escaped(name, opt.name);
+            out += "BEGIN:VCALENDAR\r\n";
+            out += "VERSION:2.0\r\n";
+            out += "PRODID:-//chinese-calendar//ics export//ZH\r\n";
+            out += "CALSCALE:GREGORIAN\r\n";
+            out += "METHOD:PUBLISH\r\n";
+            append_line(out, name);
+        }
+
+        static void append_footer(std::string &out) {
+            out += "END:VCALENDAR\r\n";
+        }
+
+        // 一个全天事件
+        static void append_event(std::string &out, const options_t &opt, const char *uid, astronomy::day_number_t day, const char *summary, const char *description) {
+            int y, m, d;
+            char buf[64];
+            std::string line;
+
+            out += "BEGIN:VEVENT\r\n";
+            line = "UID:";
+            line += uid;
+            line += '@';
+            line += opt.uid_domain;
+            append_line(out, line);
+            out += "DTSTAMP:20000101T000000Z\r\n";
+            astronomy::gregorian_from_day_number(day, &y, &m, &d);
+            snprintf(buf, sizeof(buf), "DTSTART;VALUE=DATE:%.4d%.2d%.2d\r\n", y, m, d);
+            out += buf;
+            astronomy::gregorian_from_day_number(day + 1, &y, &m, &d);
+            snprintf(buf, sizeof(buf), "DTEND;VALUE=DATE:%.4d%.2d%.2d\r\n", y, m, d);
+            out += buf;
+            line = "SUMMARY:";
+            append_escaped(line, summary);
+            append_line(out, line);
+            if (description != nullptr) {
+                line = "DESCRIPTION:";
+                append_escaped(line, description);
+                append_line(out, line);
+            }
+            out += "TRANSP:TRANSPARENT\r\n";
+            out += "END:VEVENT\r\n";
+        }
+
+        static bool exportable(const lunar_year_t &ly) {
+            int y0, y1, m, d;
+            astronomy::gregorian_from_day_number(ly.months[0].first_day, &y0, &m, &d);
+            astronomy::gregorian_from_day_number(ly.end_day, &y1, &m, &d);
+            return y0 >= 1 && y1 <= 9999;
+        }
+
+        // 一个农历年的全部事件，超出0001~9999年时返回false且不输出
+        static bool append_year(std::string &out, const lunar_year_t &ly, const options_t &opt) {
+            if (!exportable(ly)) return false;
+
+            char uid[64], summary[64], description[128];
+            const int year_sexagenary = ((ly.year - 4) % 60 + 60) % 60;
+            const char *year_stem = celestial_stems[year_sexagenary % 10];
+            const char *year_branch = terrestrial_branches[year_sexagenary % 12];
+
+            for (int i = 0; i < ly.month_count; ++i) {
+                const lunar_month_t &lm = ly.months[i];
+                const astronomy::day_number_t next = i + 1 < ly.month_count ? ly.months[i + 1].first_day : ly.end_day;
+                const char *leap = lm.leap ? "閏" : "";
+                const char *size = lm.major ? "大" : "小";
+
+                if (opt.kinds & ICS_LUNAR_DAYS) {
+                    for (astronomy::day_number_t day = lm.first_day; day < next; ++day) {
+                        const int n = day - lm.first_day;
+                        const int s = astronomy::sexagenary_day(day);
+                        snprintf(uid, sizeof(uid), "lunar-%d-%s%.2d-%.2d", ly.year, lm.leap ? "L" : "", lm.month, n + 1);
+                        if (n == 0) snprintf(summary, sizeof(summary), "%s%s%s", leap, month_names[lm.month - 1], size);
+                        else snprintf(summary, sizeof(summary), "%s", day_names[n]);
+                        snprintf(description, sizeof(description), "%s%s年%s%s%s %s%s日", year_stem, year_branch, leap, month_names[lm.month - 1], day_names[n],
+                            celestial_stems[s % 10], terrestrial_branches[s % 12]);
+                        append_event(out, opt, uid, day, summary, description);
+                    }
+                }
+                else if (opt.kinds & ICS_LUNAR_MONTHS) {
+                    snprintf(uid, sizeof(uid), "month-%d-%s%.2d", ly.year, lm.leap ? "L" : "", lm.month);
+                    snprintf(summary, sizeof(summary), "%s%s%s", leap, month_names[lm.month - 1], size);
+                    snprintf(description, sizeof(description), "%s%s年%s%s%s", year_stem, year_branch, leap, month_names[lm.month - 1], size);
+                    append_event(out, opt, uid, lm.first_day, summary, description);
+                }
+            }
+
+            if (opt.kinds & ICS_SOLAR_TERMS) {
+                for (int i = 0; i < ly.term_count; ++i) {
+                    int y, m, d;
+                    astronomy::gregorian_from_day_number(ly.terms[i].day, &y, &m, &d);
+                    snprintf(uid, sizeof(uid), "term-%.4d%.2d%.2d-%.2d", y, m, d, ly.terms[i].index);
+                    append_event(out, opt, uid, ly.terms[i].day, solar_terms_names[ly.terms[i].index], nullptr);
+                }
+            }
+
+            if (opt.kinds & ICS_FESTIVALS) {
+                festival_year_t fy;
+                calc_festivals(ly, fy);
+                for (int f = 0; f < FESTIVAL_COUNT; ++f) {
+                    if (fy.days[f] == INT_MIN) continue;
+                    snprintf(uid, sizeof(uid), "festival-%d-%s", ly.year, festival_keys[f]);
+                    append_event(out, opt, uid, fy.days[f], festival_names[f], nullptr);
+                }
+            }
+            return true;
+        }
+
+        // 导出农历first_year ~ last_year年，sink(const std::string &)依次收到各段输出，拼接即为完整的文件
+        // 各线程按块取年份，块按顺序交给sink；同时在内存中的块不超过threads * 2个
+        // 有年份超出0001~9999年时返回false，已输出的部分仍是完整的日历
+        template <class Sink>
+        static bool export_years(int first_year, int last_year, const options_t &opt, Sink &&sink) {
+            std::string head;
+            append_header(head, opt);
+            sink(static_cast<const std::string &>(head));
+
+            const int per_chunk = std::max(1, opt.years_per_chunk);
+            const int chunk_count = last_year >= first_year ? (last_year - first_year) / per_chunk + 1 : 0;
+            const int threads = std::max(1, std::min(opt.threads, chunk_count));
+            const int window = threads * 2;
+
+            struct chunk_t {
+                std::string text;
+                bool ready = false;
+                bool ok = true;
+            };
+            std::vector<chunk_t> chunks(window);  // 第k块放在chunks[k % window]
+            std::mutex mutex;
+            std::condition_variable produced, consumed;
+            int next_chunk = 0, written = 0;
+
+            auto work = [&]() {
+                calendar_context ctx(opt.mode, opt.rule, per_chunk + 2);
+                std::string text;
+                for (;;) {
+                    int k;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        if (next_chunk >= chunk_count) return;
+                        k = next_chunk++;
+                        consumed.wait(lock, [&] { return k < written + window; });
+                    }
+
+                    text.clear();
+                    bool ok = true;
+                    const int y0 = first_year + k * per_chunk, y1 = std::min(last_year, y0 + per_chunk - 1);
+                    for (int y = y0; y <= y1; ++y) ok = append_year(text, ctx.lunar_year(y), opt) && ok;
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    chunk_t &c = chunks[k % window];
+                    c.text.swap(text);
+                    c.ok = ok;
+                    c.ready = true;
+                    produced.notify_all();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (int t = 1; t < threads; ++t) workers.emplace_back(work);
+
+            // 单线程时本线程边算边写，否则本线程只负责按顺序写出
+            bool ok = true;
+            if (threads == 1) {
+                calendar_context ctx(opt.mode, opt.rule, 4);
+                std::string text;
+                for (int y = first_year; y <= last_year; ++y) {
+                    text.clear();
+                    ok = append_year(text, ctx.lunar_year(y), opt) && ok;
+                    sink(static_cast<const std::string &>(text));
+                }
+            }
+            else {
+                std::string text;
+                for (int k = 0; k < chunk_count; ++k) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        chunk_t &c = chunks[k % window];
+                        produced.wait(lock, [&] { return c.ready; });
+                        text.swap(c.text);
+                        ok = c.ok && ok;
+                        c.ready = false;
+                    }
+                    sink(static_cast<const std::string &>(text));
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ++written;
+                        consumed.notify_all();
+                    }
+                }
+            }
+            for (auto &w : workers) w.join();
+
+            std::string tail;
+            append_footer(tail);
+            sink(static_cast<const std::string &>(tail));
+            return ok;
+        }
+
+        static bool export_file(const char *path, int first_year, int last_year, const options_t &opt) {
+            FILE *fp = path != nullptr ? fopen(path, "wb") : stdout;
+            if (fp == nullptr) return false;
+            bool ok = export_years(first_year, last_year, opt, [fp](const std::string &s) {
+                fwrite(s.data(), 1, s.size(), fp);
+            });
+            ok = fflush(fp) == 0 && ok;
+            if (fp != stdout) ok = fclose(fp) == 0 && ok;
+            return ok;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,366 @@
+﻿#ifndef _INCREMENTAL_H_
+#define _INCREMENTAL_H_
+
+#include "calendar.h"
+#include "context.h"
+#include "shard.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace calendar {
+    // 按依赖增量重算农历年表（shard::generate不分片时的格式）
+    // 年表旁另存依赖文件<path>.deps：
+    //   #chncal-deps 1
+    //   #series <指纹>                   全部周期项系数表（VSOP87、ELP2000、章动）的指纹
+    //   #delta-t <起始年>:<指纹>...      ΔT表（astronomy::impl::D）各段的指纹，段以起始年标识
+    //   <年> <所依赖各段的起始年，逗号分隔>
+    // 一个农历年只用到上年冬至前约70日至下年冬至后约70日的事件，只依赖覆盖这段力学时的一两段ΔT
+    // 重算时，年表头部（范围、精度档、时区）或周期项系数有变则全部重算；否则只重算所依赖的段有变的年份
+    // 段的指纹包括起止年与系数，在表中插入一行时被拆开的那段也算有变
+    // 算法本身的改动检测不到，须删去依赖文件全部重算
+    namespace incremental {
+        static constexpr int DEPS_FORMAT_VERSION = 1;
+
+        // 事件所在力学时以外另留的余量（日）：ΔT、时区与certified档的误差区间都在两日以内
+        static constexpr astronomy::REAL SPAN_MARGIN_DAYS = 2;
+
+        // 按数值而非内存布局计算，与long double的填充字节无关
+        static std::uint64_t fingerprint_real(astronomy::REAL v, std::uint64_t h) {
+            int e = 0;
+            const astronomy::REAL m = std::frexp(std::fabs(v), &e);
+            const std::uint64_t parts[3] = { (std::uint64_t)(v < 0), (std::uint64_t)(std::int64_t)e, (std::uint64_t)std::ldexp(m, 64) };
+            return shard::fnv1a(reinterpret_cast<const char *>(parts), sizeof(parts), h);
+        }
+
+        template <class T, std::size_t N>
+        static std::uint64_t fingerprint_table(const T (&table)[N], std::uint64_t h) {
+            const std::size_t fields = sizeof(T) / sizeof(astronomy::REAL);
+            for (std::size_t i = 0; i < N; ++i) {
+                const astronomy::REAL *f = reinterpret_cast<const astronomy::REAL *>(&table[i]);
+                for (std::size_t k = 0; k < fields; ++k) h = fingerprint_real(f[k], h);
+            }
+            return fingerprint_real((astronomy::REAL)N, h);
+        }
+
+        static std::uint64_t series_fingerprint() {
+            typedef astronomy::impl I;
+            std::uint64_t h = shard::fnv1a(nullptr, 0);
+            h = fingerprint_table(I::E10, h);
+            h = fingerprint_table(I::E11, h);
+            h = fingerprint_table(I::E12, h);
+            h = fingerprint_table(I::E13, h);
+            h = fingerprint_table(I::E14, h);
+            h = fingerprint_table(I::E15, h);
+            h = fingerprint_table(I::E20, h);
+            h = fingerprint_table(I::E21, h);
+            h = fingerprint_table(I::M10, h);
+            h = fingerprint_table(I::M11, h);
+            h = fingerprint_table(I::M12, h);
+            h = fingerprint_table(I::M20, h);
+            h = fingerprint_table(I::M21, h);
+            h = fingerprint_table(I::NT, h);
+            return h;
+        }
+
+        struct segment_t {
+            int since;  // 起始年
+            std::uint64_t fingerprint;
+        };
+
+        // ΔT表的各段，最后一行只作为末段的终点
+        static std::vector<segment_t> delta_t_segments() {
+            typedef astronomy::impl I;
+            const std::size_t length = sizeof(I::D) / sizeof(*I::D);
+            std::vector<segment_t> out;
+            for (std::size_t i = 0; i + 1 < length; ++i) {
+                const auto &d = I::D[i];
+                std::uint64_t h = shard::fnv1a(nullptr, 0);
+                h = fingerprint_real(d.y, h);
+                h = fingerprint_real(I::D[i + 1].y, h);
+                h = fingerprint_real(d.a0, h);
+                h = fingerprint_real(d.a1, h);
+                h = fingerprint_real(d.a2, h);
+                h = fingerprint_real(d.a3, h);
+                out.push_back({ d.y, h });
+            }
+            return out;
+        }
+
+        // 农历年y所依赖的ΔT段的起始年
+        // 事件流从lunar_year_events_start(y)开始，最后一个事件是下年冬至或其后约两个月的朔
+        static std::vector<int> year_dependencies(int y) {
+            const astronomy::REAL begin = lunar_year_events_start(y) - SPAN_MARGIN_DAYS;
+            const astronomy::REAL end = estimate_solar_term(y + 1, 270) + 70 + SPAN_MARGIN_DAYS;
+            std::vector<int> out;
+            for (std::size_t i = astronomy::get_delta_t_segment(begin); i <= astronomy::get_delta_t_segment(end); ++i) {
+                out.push_back(astronomy::impl::D[i].y);
+            }
+            return out;
+        }
+
+        struct deps_t {
+            std::uint64_t series = 0;
+            std::vector<segment_t> segments;
+            std::map<int, std::vector<int>> years;
+        };
+
+        static void format_deps(const deps_t &deps, std::string &out) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "#chncal-deps %d\n#series %016llx\n#delta-t", DEPS_FORMAT_VERSION, (unsigned long long)deps.series);
+            out += buf;
+            for (const auto &s : deps.segments) {
+                snprintf(buf, sizeof(buf), " %d:%016llx", s.since, (unsigned long long)s.fingerprint);
+                out += buf;
+            }
+            out += '\n';
+            for (const auto &y : deps.years) {
+                snprintf(buf, sizeof(buf), "%d\t", y.first);
+                out += buf;
+                for (std::size_t i = 0; i < y.second.size(); ++i) {
+                    snprintf(buf, sizeof(buf), "%s%d", i ? "," : "", y.second[i]);
+                    out += buf;
+                }
+                out += '\n';
+            }
+        }
+
+        static bool read_file(const std::string &path, std::string &data) {
+            FILE *fp = fopen(path.c_str(), "rb");
+            if (fp == nullptr) return false;
+            char chunk[65536];
+            std::size_t n;
+            data.clear();
+            while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) data.append(chunk, n);
+            fclose(fp);
+            return true;
+        }
+
+        static bool read_deps(const std::string &path, deps_t &deps) {
+            std::string data;
+            if (!read_file(path, data)) return false;
+            deps = deps_t();
+            bool header = false;
+            std::size_t pos = 0;
+            while (pos < data.size()) {
+                std::size_t e = data.find('\n', pos);
+                if (e == std::string::npos) return false;
+                const std::string line = data.substr(pos, e - pos);
+                pos = e + 1;
+
+                const char *p = line.c_str();
+                if (line.compare(0, 13, "#chncal-deps ") == 0) {
+                    header = atoi(p + 13) == DEPS_FORMAT_VERSION;
+                }
+                else if (line.compare(0, 8, "#series ") == 0) {
+                    unsigned long long v;
+                    if (sscanf(p + 8, "%llx", &v) != 1) return false;
+                    deps.series = v;
+                }
+                else if (line.compare(0, 8, "#delta-t") == 0) {
+                    p += 8;
+                    int since, n;
+                    unsigned long long v;
+                    while (sscanf(p, " %d:%llx%n", &since, &v, &n) == 2) {
+                        deps.segments.push_back({ since, v });
+                        p += n;
+                    }
+                }
+                else {
+                    int year, n;
+                    if (sscanf(p, "%d%n", &year, &n) != 1) return false;
+                    std::vector<int> &segs = deps.years[year];
+                    p += n;
+                    int since;
+                    while (sscanf(p, " %d%n", &since, &n) == 1 || sscanf(p, ",%d%n", &since, &n) == 1) {
+                        segs.push_back(since);
+                        p += n;
+                    }
+                }
+            }
+            return header;
+        }
+
+        // 完整年表：头部与各年份行（不含换行），校验和须正确
+        struct table_t {
+            std::string header;
+            int first_year, last_year;
+            std::vector<std::string> lines;
+        };
+
+        static bool read_table(const std::string &path, table_t &t) {
+            std::string data;
+            if (!read_file(path, data)) return false;
+            t.header.clear();
+            t.lines.clear();
+            std::uint64_t checksum = shard::fnv1a(nullptr, 0);
+            bool end_seen = false;
+            std::size_t pos = 0;
+            while (pos < data.size()) {
+                std::size_t e = data.find('\n', pos);
+                if (e == std::string::npos || end_seen) return false;
+                const std::string line = data.substr(pos, e + 1 - pos);
+                pos = e + 1;
+
+                if (line[0] != '#') {
+                    checksum = shard::fnv1a(line.data(), line.size(), checksum);
+                    t.lines.push_back(line.substr(0, line.size() - 1));
+                }
+                else if (line.compare(0, 5, "#end ") == 0) {
+                    std::size_t count;
+                    unsigned long long sum;
+                    if (sscanf(line.c_str(), "#end %zu %llx", &count, &sum) != 2 || count != t.lines.size() || sum != checksum) return false;
+                    end_seen = true;
+                }
+                else {
+                    if (!t.lines.empty() || line.compare(0, 7, "#shard ") == 0) return false;
+                    if (line.compare(0, 7, "#range ") == 0 && sscanf(line.c_str(), "#range %d %d", &t.first_year, &t.last_year) != 2) return false;
+                    t.header += line;
+                }
+            }
+            return end_seen && t.lines.size() == (std::size_t)(t.last_year - t.first_year + 1);
+        }
+
+        // 某年某个朔日或节气的变化；before或after为空表示原来没有或现在没有（如闰月改变）
+        // key为月名（[L]月）或节气序号，前加m或t区分
+        struct change_t {
+            int year;
+            std::string key;
+            std::string before, after;
+        };
+
+        // 年份行的各项按键拆开，同一键出现多次（同一农历年内两个立春）时加序号
+        static std::vector<std::pair<std::string, std::string>> split_year_line(const std::string &line) {
+            std::vector<std::pair<std::string, std::string>> out;
+            std::map<std::string, int> seen;
+            char section = 0;
+            std::size_t pos = 0;
+            while (pos <= line.size()) {
+                std::size_t e = line.find('\t', pos);
+                if (e == std::string::npos) e = line.size();
+                const std::string field = line.substr(pos, e - pos);
+                pos = e + 1;
+
+                if (field == "|") {
+                    section = section == 0 ? 'm' : 't';
+                    continue;
+                }
+                const std::size_t eq = field.find('=');
+                if (section == 0 || eq == std::string::npos) continue;
+                std::string key = std::string(1, section) + field.substr(0, eq);
+                const int n = ++seen[key];
+                if (n > 1) key += "#" + std::to_string(n);
+                out.emplace_back(key, field.substr(eq + 1));
+            }
+            return out;
+        }
+
+        static void diff_year_lines(int year, const std::string &before, const std::string &after, std::vector<change_t> &changes) {
+            if (before == after) return;
+            const auto a = split_year_line(before), b = split_year_line(after);
+            std::map<std::string, std::string> old_values(a.begin(), a.end());
+            for (const auto &kv : b) {
+                const auto it = old_values.find(kv.first);
+                if (it == old_values.end()) {
+                    changes.push_back({ year, kv.first, std::string(), kv.second });
+                    continue;
+                }
+                if (it->second != kv.second) changes.push_back({ year, kv.first, it->second, kv.second });
+                old_values.erase(it);
+            }
+            for (const auto &kv : a) {
+                if (old_values.count(kv.first)) changes.push_back({ year, kv.first, kv.second, std::string() });
+            }
+        }
+
+        struct result_t {
+            int recomputed = 0;  // 重算的年数
+            int changed_years = 0;
+            bool full = false;  // 是否全部重算（首次生成，或头部、周期项系数有变）
+            std::vector<change_t> changes;
+        };
+
+        // 生成或增量更新path处first_year ~ last_year的年表及其依赖文件
+        // 原有年表头部相同时，重算的各年与原来逐项比对，变了的朔日、节气记入result.changes
+        static bool regenerate(const char *path, int first_year, int last_year, calc_mode_t mode, const timezone_rule_t &rule, result_t &result, std::string &error) {
+            result = result_t();
+            if (last_year < first_year) {
+                error = "empty range";
+                return false;
+            }
+
+            std::string header;
+            shard::format_header(header, first_year, last_year, mode, rule);
+            deps_t deps;
+            deps.series = series_fingerprint();
+            deps.segments = delta_t_segments();
+
+            table_t old;
+            deps_t old_deps;
+            const std::string deps_path = std::string(path) + ".deps";
+            const bool have_old = read_table(path, old) && old.header == header;
+            result.full = !have_old || !read_deps(deps_path, old_deps) || old_deps.series != deps.series;
+
+            // 有变的段：现在的表中没有同一起始、同一指纹的段的，旧表中的段
+            std::map<int, std::uint64_t> current;
+            for (const auto &s : deps.segments) current[s.since] = s.fingerprint;
+            std::vector<int> changed;
+            for (const auto &s : old_deps.segments) {
+                const auto it = current.find(s.since);
+                if (it == current.end() || it->second != s.fingerprint) changed.push_back(s.since);
+            }
+
+            calendar_context ctx(mode, rule, 4);
+            std::string body;
+            for (int y = first_year; y <= last_year; ++y) {
+                const std::string *before = have_old ? &old.lines[(std::size_t)(y - first_year)] : nullptr;
+                bool affected = result.full;
+                if (!affected) {
+                    const auto it = old_deps.years.find(y);
+                    affected = it == old_deps.years.end();
+                    for (std::size_t i = 0; !affected && i < it->second.size(); ++i) {
+                        affected = std::find(changed.begin(), changed.end(), it->second[i]) != changed.end();
+                    }
+                }
+
+                if (!affected) {
+                    body += *before;
+                    body += '\n';
+                    deps.years[y] = old_deps.years[y];
+                    continue;
+                }
+
+                std::string line;
+                shard::format_year(ctx.lunar_year(y), line);
+                body += line;
+                deps.years[y] = year_dependencies(y);
+                ++result.recomputed;
+                if (before != nullptr && line.compare(0, line.size() - 1, *before) != 0) {
+                    ++result.changed_years;
+                    diff_year_lines(y, *before, line.substr(0, line.size() - 1), result.changes);
+                }
+            }
+
+            std::string out = header + body;
+            shard::format_end(out, (std::size_t)(last_year - first_year + 1), shard::fnv1a(body.data(), body.size()));
+            std::string deps_out;
+            format_deps(deps, deps_out);
+            // 先写年表再写依赖：写依赖失败时，下次仍按旧的依赖判断，受影响的年份再算一次，结果不会错
+            if (!shard::write_file(path, out) || !shard::write_file(deps_path, deps_out)) {
+                error = std::string(path) + ": cannot write";
+                return false;
+            }
+            return true;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+﻿#ifndef _PACKED_YEARS_H_
+#define _PACKED_YEARS_H_
+
+#include "calendar.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace calendar {
+    // 压缩的农历年，16字节，只保存日期，不保存时刻
+    // 从低位起：
+    //   8位  正月初一距公历（格里高利历外推）1月1日的日数 + 32
+    //   4位  闰几月，无闰为0
+    //   1位  月数 - 12
+    //   13位 各月大小，1为大月
+    //   5位  第一个节气的序号（0小寒 ~ 23冬至）
+    //   5位  节气个数
+    //   5位  第一个节气距正月初一的日数
+    //   3位 x (节气个数 - 1)  相邻节气的日差 - 13
+    struct packed_year_t {
+        std::uint64_t bits[2];
+    };
+
+    namespace detail {
+        constexpr int PACKED_NEW_YEAR_BIAS = 32;
+        constexpr int PACKED_TERM_DELTA_BASE = 13;
+
+        class bit_writer {
+        public:
+            explicit bit_writer(packed_year_t &p) : _p(p) {
+                _p.bits[0] = _p.bits[1] = 0;
+            }
+
+            // value须在[0, 2^n)之内，否则返回false
+            bool put(int value, int n) {
+                if (value < 0 || value >= (1 << n) || _pos + n > 128) return false;
+                const int w = _pos >> 6, o = _pos & 63;
+                _p.bits[w] |= (std::uint64_t)value << o;
+                if (o + n > 64) _p.bits[1] |= (std::uint64_t)value >> (64 - o);
+                _pos += n;
+                return true;
+            }
+
+        private:
+            packed_year_t &_p;
+            int _pos = 0;
+        };
+
+        class bit_reader {
+        public:
+            explicit bit_reader(const packed_year_t &p) : _p(p) {
+            }
+
+            int get(int n) {
+                const int w = _pos >> 6, o = _pos & 63;
+                std::uint64_t v = _p.bits[w] >> o;
+                if (o + n > 64) v |= _p.bits[1] << (64 - o);
+                _pos += n;
+                return (int)(v & ((1ULL << n) - 1));
+            }
+
+        private:
+            const packed_year_t &_p;
+            int _pos = 0;
+        };
+    }
+
+    // 解码，jd与local均置为0，ambiguous均为false
+    static void unpack_lunar_year(int y, const packed_year_t &p, lunar_year_t &ly) {
+        detail::bit_reader r(p);
+        const astronomy::day_number_t new_year = astronomy::day_number_from_gregorian(y, 1, 1) + r.get(8) - detail::PACKED_NEW_YEAR_BIAS;
+        const int leap = r.get(4);
+        const int month_count = 12 + r.get(1);
+        const int major = r.get(13);
+
+        ly.year = y;
+        ly.month_count = month_count;
+        ly.leap_month = leap;
+
+        astronomy::day_number_t day = new_year;
+        for (int i = 0, month = 1; i < month_count; ++i) {
+            lunar_month_t &m = ly.months[i];
+            m.first_day = day;
+            m.leap = leap != 0 && i == leap;
+            m.month = m.leap ? leap : month++;
+            m.major = (major >> i) & 1;
+            m.ambiguous = false;
+            m.jd = 0;
+            m.local = 0;
+            day += m.major ? 30 : 29;
+        }
+        ly.end_day = day;
+
+        const int first_index = r.get(5);
+        ly.term_count = r.get(5);
+        day = new_year + r.get(5);
+        for (int i = 0; i < ly.term_count; ++i) {
+            if (i > 0) day += r.get(3) + detail::PACKED_TERM_DELTA_BASE;
+            solar_term_day_t &t = ly.terms[i];
+            t.day = day;
+            t.index = (first_index + i) % 24;
+            t.ambiguous = false;
+            t.jd = 0;
+            t.local = 0;
+        }
+    }
+
+    // 编码，超出位宽或月序与闰月不符时返回false
+    static bool pack_lunar_year(const lunar_year_t &ly, packed_year_t &p) {
+        detail::bit_writer w(p);
+        const astronomy::day_number_t new_year = ly.months[0].first_day;
+
+        int major = 0;
+        for (int i = 0; i < ly.month_count; ++i) {
+            if (ly.months[i].major) major |= 1 << i;
+        }
+
+        bool ok = ly.month_count >= 12 && ly.term_count > 0
+            && w.put(new_year - astronomy::day_number_from_gregorian(ly.year, 1, 1) + detail::PACKED_NEW_YEAR_BIAS, 8)
+            && w.put(ly.leap_month, 4)
+            && w.put(ly.month_count - 12, 1)
+            && w.put(major, 13)
+            && w.put(ly.terms[0].index, 5)
+            && w.put(ly.term_count, 5)
+            && w.put(ly.terms[0].day - new_year, 5);
+        for (int i = 1; ok && i < ly.term_count; ++i) {
+            ok = w.put(ly.terms[i].day - ly.terms[i - 1].day - detail::PACKED_TERM_DELTA_BASE, 3);
+        }
+        if (!ok) return false;
+
+        // 月序由闰月推出，须与原来的一致
+        lunar_year_t check;
+        unpack_lunar_year(ly.year, p, check);
+        for (int i = 0; i < ly.month_count; ++i) {
+            if (check.months[i].month != ly.months[i].month || check.months[i].leap != ly.months[i].leap) return false;
+        }
+        return check.end_day == ly.end_day;
+    }
+
+    // 连续多年的压缩农历，按年下标直接取
+    // 无法压缩的年记为无效，查询时改为实时计算
+    class packed_year_table {
+    public:
+        packed_year_table() = default;
+
+        packed_year_table(int first_year, int last_year, calc_mode_t mode = CALC_ADAPTIVE, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+            build(first_year, last_year, mode, rule);
+        }
+
+        void build(int first_year, int last_year, calc_mode_t mode = CALC_ADAPTIVE, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+            _first = first_year;
+            _mode = mode;
+            _rule = rule;
+            _records.assign(last_year >= first_year ? last_year - first_year + 1 : 0, invalid());
+            lunar_year_solver solver(mode);
+            for (int y = first_year; y <= last_year; ++y) {
+                const astronomy::REAL tz = timezone_offset(rule, y);
+                lunar_year_events_t ev;
+                lunar_year_t ly;
+                solver.solve(y, &tz, 1, ev);
+                bin_lunar_year(ev, tz, ly);
+                packed_year_t &p = _records[y - first_year];
+                if (!pack_lunar_year(ly, p)) p = invalid();
+            }
+        }
+
+        bool contains(int y) const { return y >= _first && y - _first < (int)_records.size(); }
+
+        const packed_year_t &at(int y) const { return _records[y - _first]; }
+
+        // 在表中且能压缩
+        bool packed(int y) const { return contains(y) && !is_invalid(at(y)); }
+
+        void lunar_year(int y, lunar_year_t &ly) const {
+            if (packed(y)) {
+                unpack_lunar_year(y, at(y), ly);
+            }
+            else {
+                calc_lunar_year(y, ly, _mode, _rule);
+            }
+        }
+
+        std::size_t size_in_bytes() const { return _records.size() * sizeof(packed_year_t); }
+
+    private:
+        static packed_year_t invalid() { return { { ~0ULL, ~0ULL } }; }
+        static bool is_invalid(const packed_year_t &p) { return p.bits[0] == ~0ULL && p.bits[1] == ~0ULL; }
+
+        int _first = 0;
+        calc_mode_t _mode = CALC_ADAPTIVE;
+        timezone_rule_t _rule = TIMEZONE_RULE_CHINA;
+        std::vector<packed_year_t> _records;
+    };
+}
+
+#endif
@@ -0,0 +1,192 @@
+﻿#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "calendar.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace calendar {
+    // 流水线生成连续的农历年：求解 → 归日 → 排月 → 格式化与写出
+    //   求解：lunar_year_solver，solvers个线程；各年按block_years年一段分段，第k个线程负责第k、k + solvers……段
+    //         段内连续各年共用一个事件流，相邻两年重叠的节气与朔只求解一次，每段开头多求解上一年的部分
+    //   归日：力学时换算为世界时、按时区归日（bin_lunar_year_days），按年份顺序轮流从各求解线程的队列取
+    //   排月：定闰月、排出各月（label_lunar_year）
+    //   写出：调用者的write，在调用run的线程中
+    // 级间为有界的单生产者单消费者无锁队列，结果与逐年calc_lunar_year相同且按年份顺序写出
+    // 写出阻塞时前面各级照常运行，直到队列满才等待（背压），所以已求解未写出的年份不超过各队列容量之和
+    namespace pipeline {
+        // 单生产者单消费者环形队列，容量取不小于capacity的2的幂
+        // 生产者只写_tail，消费者只写_head，满或空时try_*返回false，不加锁
+        template <class T>
+        class spsc_queue {
+        public:
+            explicit spsc_queue(std::size_t capacity) {
+                std::size_t n = 2;
+                while (n < capacity) n *= 2;
+                _items.resize(n);
+                _mask = n - 1;
+            }
+
+            bool try_push(T &v) {
+                const std::size_t tail = _tail.load(std::memory_order_relaxed);
+                if (tail - _head.load(std::memory_order_acquire) > _mask) return false;
+                _items[tail & _mask] = std::move(v);
+                _tail.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool try_pop(T &v) {
+                const std::size_t head = _head.load(std::memory_order_relaxed);
+                if (head == _tail.load(std::memory_order_acquire)) return false;
+                v = std::move(_items[head & _mask]);
+                _head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            std::vector<T> _items;
+            std::size_t _mask;
+            // 生产者与消费者各自频繁写的计数分开放，避免同一缓存行来回传递
+            std::atomic<std::size_t> _head{ 0 };
+            char _pad[64];
+            std::atomic<std::size_t> _tail{ 0 };
+        };
+
+        // 一级的吞吐计数，求解级为各线程之和
+        struct stage_stats_t {
+            const char *name;
+            std::size_t items = 0;
+            double busy_seconds = 0;  // 处理用时
+            double wait_seconds = 0;  // 等上一级（队列空）与等下一级（队列满）的时间
+        };
+
+        namespace detail {
+            typedef std::chrono::steady_clock clock;
+
+            static double seconds_since(clock::time_point t0) {
+                return std::chrono::duration<double>(clock::now() - t0).count();
+            }
+
+            // 队列满或空时让出时间片再试，等待时间计入stats
+            template <class T>
+            static void push(spsc_queue<T> &q, T &v, stage_stats_t &stats) {
+                if (q.try_push(v)) return;
+                const auto t0 = clock::now();
+                while (!q.try_push(v)) std::this_thread::yield();
+                stats.wait_seconds += seconds_since(t0);
+            }
+
+            template <class T>
+            static void pop(spsc_queue<T> &q, T &v, stage_stats_t &stats) {
+                if (q.try_pop(v)) return;
+                const auto t0 = clock::now();
+                while (!q.try_pop(v)) std::this_thread::yield();
+                stats.wait_seconds += seconds_since(t0);
+            }
+        }
+
+        struct options_t {
+            int solvers = 1;
+            std::size_t queue_capacity = 16;  // 每个队列
+            int block_years = 16;  // 每段的年数，越长重解越少，但线程间越难均衡
+        };
+
+        // first ~ last各年依次交给write(const lunar_year_t &)，返回求解、归日、排月、写出四级的计数
+        template <class Write>
+        static std::vector<stage_stats_t> run(int first, int last, calc_mode_t mode, const timezone_rule_t &rule, const options_t &opt, Write write) {
+            std::vector<stage_stats_t> stats(4);
+            stats[0].name = "solve";
+            stats[1].name = "bin";
+            stats[2].name = "label";
+            stats[3].name = "write";
+            if (last < first) return stats;
+
+            const int count = last - first + 1;
+            const int block = std::max(1, opt.block_years);
+            const int blocks = (count + block - 1) / block;
+            const int solvers = std::max(1, std::min(opt.solvers, blocks));
+            const std::size_t capacity = std::max<std::size_t>(1, opt.queue_capacity);
+            std::vector<std::unique_ptr<spsc_queue<lunar_year_events_t>>> solved;
+            for (int k = 0; k < solvers; ++k) solved.emplace_back(new spsc_queue<lunar_year_events_t>(capacity));
+            spsc_queue<binned_lunar_year_t> binned(capacity);
+            spsc_queue<lunar_year_t> labeled(capacity);
+            std::vector<stage_stats_t> solver_stats(solvers);
+
+            std::vector<std::thread> threads;
+            for (int k = 0; k < solvers; ++k) {
+                threads.emplace_back([&, k]() {
+                    stage_stats_t &st = solver_stats[k];
+                    lunar_year_solver solver(mode);
+                    lunar_year_events_t ev;
+                    for (int b = k; b < blocks; b += solvers) {
+                        const int end = std::min(count, (b + 1) * block);
+                        for (int i = b * block; i < end; ++i) {
+                            const int y = first + i;
+                            const auto t0 = detail::clock::now();
+                            const astronomy::REAL tz = timezone_offset(rule, y);
+                            solver.solve(y, &tz, 1, ev);
+                            st.busy_seconds += detail::seconds_since(t0);
+                            ++st.items;
+                            detail::push(*solved[k], ev, st);
+                        }
+                    }
+                });
+            }
+
+            threads.emplace_back([&]() {
+                stage_stats_t &st = stats[1];
+                lunar_year_events_t ev;
+                binned_lunar_year_t b;
+                for (int i = 0; i < count; ++i) {
+                    detail::pop(*solved[(i / block) % solvers], ev, st);
+                    const auto t0 = detail::clock::now();
+                    bin_lunar_year_days(ev, timezone_offset(rule, ev.year), b);
+                    st.busy_seconds += detail::seconds_since(t0);
+                    ++st.items;
+                    detail::push(binned, b, st);
+                }
+            });
+
+            threads.emplace_back([&]() {
+                stage_stats_t &st = stats[2];
+                binned_lunar_year_t b;
+                lunar_year_t ly;
+                for (int i = 0; i < count; ++i) {
+                    detail::pop(binned, b, st);
+                    const auto t0 = detail::clock::now();
+                    label_lunar_year(b, ly);
+                    st.busy_seconds += detail::seconds_since(t0);
+                    ++st.items;
+                    detail::push(labeled, ly, st);
+                }
+            });
+
+            stage_stats_t &st = stats[3];
+            lunar_year_t ly;
+            for (int i = 0; i < count; ++i) {
+                detail::pop(labeled, ly, st);
+                const auto t0 = detail::clock::now();
+                write(ly);
+                st.busy_seconds += detail::seconds_since(t0);
+                ++st.items;
+            }
+            for (auto &t : threads) t.join();
+
+            for (const auto &s : solver_stats) {
+                stats[0].items += s.items;
+                stats[0].busy_seconds += s.busy_seconds;
+                stats[0].wait_seconds += s.wait_seconds;
+            }
+            return stats;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,259 @@
+﻿#ifndef _QUERY_H_
+#define _QUERY_H_
+
+#include "calendar.h"
+#include "festivals.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace calendar {
+    // 文本查询，每行一个查询，结果为一行，字段以制表符分隔
+    //   g2l Y-M-D      公历转农历，输出 Y-M-D  农历Y-M-D（闰月记作LM，如2023-L02-01）  干支日
+    //   Y-M-D          同g2l
+    //   l2g Y-M-D      农历转公历，月份可写作LM表示闰月
+    //   year Y         农历年各月，输出 Y  闰几月  各月（月份=朔日，+大月 -小月）
+    //   terms Y        公历年内的24节气所在日
+    //   moons Y        公历年内的朔日
+    // 公历日期1582-10-15之前为儒略历，农历年为天文纪年；无法解析、无此日期或年份超出MIN_LUNAR_YEAR ~ MAX_LUNAR_YEAR时输出 error  原查询
+    namespace query {
+        // 前端的设置
+        struct options_t {
+            calc_mode_t mode = CALC_ADAPTIVE;
+            timezone_rule_t rule = TIMEZONE_RULE_CHINA;
+        };
+
+        // 含day的农历年
+        // Years为按年取农历年的缓存，如calendar_context：years.get(y)返回const lunar_year_t &，years.rule()返回时区规则
+        template <class Years>
+        static const lunar_year_t &year_containing(Years &years, astronomy::day_number_t day) {
+            int y, m, d;
+            astronomy::civil_from_day_number(day, &y, &m, &d);
+            y += (y < 0);
+            const lunar_year_t *ly = &years.get(y);
+            while (day < ly->months[0].first_day) ly = &years.get(ly->year - 1);
+            while (day >= ly->end_day) ly = &years.get(ly->year + 1);
+            return *ly;
+        }
+
+        static const char *skip_spaces(const char *p) {
+            while (*p == ' ' || *p == '\t') ++p;
+            return p;
+        }
+
+        static bool parse_int(const char *&p, int &v) {
+            char *end;
+            const long n = strtol(p, &end, 10);
+            if (end == p) return false;
+            p = end;
+            v = (int)n;
+            return true;
+        }
+
+        // Y-M-D，lunar为true时月份可以带L前缀表示闰月
+        static bool parse_date(const char *&p, int &y, int &m, bool &leap, int &d, bool lunar) {
+            leap = false;
+            if (!parse_int(p, y) || *p++ != '-') return false;
+            if (lunar && (*p == 'L' || *p == 'l')) {
+                leap = true;
+                ++p;
+            }
+            if (!parse_int(p, m) || *p++ != '-' || !parse_int(p, d)) return false;
+            return m >= 1 && m <= 12 && d >= 1 && d <= 31;
+        }
+
+        // 公历日期是否存在：无0年，换算成日序再换回须不变，排除2月30日、1582-10-05 ~ 1582-10-14等
+        static bool valid_civil(int y, int m, int d) {
+            if (y == 0) return false;
+            int y1, m1, d1;
+            astronomy::civil_from_day_number(astronomy::day_number_from_civil(y, m, d), &y1, &m1, &d1);
+            return y1 == y && m1 == m && d1 == d;
+        }
+
+        static bool at_end(const char *p) {
+            p = skip_spaces(p);
+            return *p == '\0' || *p == '\r' || *p == '\n';
+        }
+
+        static void append_civil(std::string &out, astronomy::day_number_t day) {
+            int y, m, d;
+            astronomy::civil_from_day_number(day, &y, &m, &d);
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d-%.2d-%.2d", y, m, d);
+            out += buf;
+        }
+
+        static void append_lunar(std::string &out, const lunar_date_t &ld) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d-%s%.2d-%.2d", ld.year, ld.leap ? "L" : "", ld.month, ld.day);
+            out += buf;
+        }
+
+        template <class Years>
+        static bool query_g2l(Years &years, const char *p, std::string &out) {
+            int y, m, d;
+            bool leap;
+            if (!parse_date(p, y, m, leap, d, false) || !at_end(p) || !lunar_year_supported(y) || !valid_civil(y, m, d)) return false;
+
+            const astronomy::day_number_t day = astronomy::day_number_from_civil(y, m, d);
+            lunar_date_t ld;
+            lunar_date_from_day(year_containing(years, day), day, ld);
+            const int n = astronomy::sexagenary_day(day);
+
+            append_civil(out, day);
+            out += '\t';
+            append_lunar(out, ld);
+            out += '\t';
+            out += celestial_stems[n % 10];
+            out += terrestrial_branches[n % 12];
+            return true;
+        }
+
+        template <class Years>
+        static bool query_l2g(Years &years, const char *p, std::string &out) {
+            lunar_date_t ld;
+            if (!parse_date(p, ld.year, ld.month, ld.leap, ld.day, true) || !at_end(p) || !lunar_year_supported(ld.year)) return false;
+
+            astronomy::day_number_t day;
+            if (!day_from_lunar_date(years.get(ld.year), ld.month, ld.leap, ld.day, day)) return false;
+
+            append_lunar(out, ld);
+            out += '\t';
+            append_civil(out, day);
+            return true;
+        }
+
+        template <class Years>
+        static bool query_year(Years &years, const char *p, std::string &out) {
+            int y;
+            if (!parse_int(p, y) || !at_end(p) || !lunar_year_supported(y)) return false;
+
+            const lunar_year_t &ly = years.get(y);
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d\t%d", y, ly.leap_month);
+            out += buf;
+            for (int i = 0; i < ly.month_count; ++i) {
+                const lunar_month_t &m = ly.months[i];
+                snprintf(buf, sizeof(buf), "\t%s%d=", m.leap ? "L" : "", m.month);
+                out += buf;
+                append_civil(out, m.first_day);
+                out += m.major ? '+' : '-';
+            }
+            return true;
+        }
+
+        // 公历年内的节气或朔，取自前后两个农历年
+        template <class Years>
+        static bool query_year_events(Years &years, const char *p, std::string &out, bool terms) {
+            int y;
+            if (!parse_int(p, y) || !at_end(p) || !lunar_year_supported(y)) return false;
+
+            const astronomy::day_number_t first = astronomy::day_number_from_civil(y, 1, 1);
+            const astronomy::day_number_t last = astronomy::day_number_from_civil(y + 1 == 0 ? 1 : y + 1, 1, 1);
+            const lunar_year_t &ly0 = year_containing(years, first);
+            const int y1 = ly0.year + 1;
+
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d", y);
+            out += buf;
+            for (int k = 0; k < 2; ++k) {
+                const lunar_year_t &ly = k == 0 ? ly0 : years.get(y1);
+                if (terms) {
+                    for (int i = 0; i < ly.term_count; ++i) {
+                        if (ly.terms[i].day < first || ly.terms[i].day >= last) continue;
+                        out += '\t';
+                        out += solar_terms_names[ly.terms[i].index];
+                        out += '=';
+                        append_civil(out, ly.terms[i].day);
+                    }
+                }
+                else {
+                    for (int i = 0; i < ly.month_count; ++i) {
+                        if (ly.months[i].first_day < first || ly.months[i].first_day >= last) continue;
+                        out += '\t';
+                        append_civil(out, ly.months[i].first_day);
+                    }
+                }
+            }
+            return true;
+        }
+
+        template <class Years>
+        static bool query_events(Years &years, const char *p, std::string &out) {
+            int y, m, d, n;
+            bool leap;
+            if (!parse_date(p, y, m, leap, d, false) || !parse_int(p, n) || !at_end(p) || n < 0 || n > 1000 || !lunar_year_supported(y) || !valid_civil(y, m, d)) return false;
+
+            const astronomy::REAL tz = timezone_offset(years.rule(), y);
+            astronomy::REAL jd = astronomy::julian_day_from_civil(y, m, d, 0, 0, 0.0) - tz;
+            jd += astronomy::calc_delta_t(jd);
+
+            append_civil(out, astronomy::day_number_from_civil(y, m, d));
+            event_stream stream(jd);
+            char buf[64];
+            for (int i = 0; i < n; ++i) {
+                const astro_event_t e = stream.next();
+                const astronomy::REAL local = e.jd + tz;
+                astronomy::daytime_t dt;
+                astronomy::daytime_from_julian_day(local - astronomy::calc_delta_t(local), &dt);
+                snprintf(buf, sizeof(buf), "\t%s=%d-%.2d-%.2dT%.2d:%.2d:%.2d",
+                    e.type == EVENT_SOLAR_TERM ? solar_terms_names[e.index] : moon_phase_names[e.index],
+                    dt.year, dt.month, dt.day, dt.hour, dt.minute, (int)dt.second);
+                out += buf;
+            }
+            return true;
+        }
+
+        template <class Years>
+        static bool query_festival(Years &years, const char *p, std::string &out) {
+            const char *e = p;
+            while (*e != '\0' && *e != ' ' && *e != '\t') ++e;
+            const std::string name(p, e);
+            const int f = find_festival(name.c_str());
+            int a, b;
+            p = e;
+            if (f < 0 || !parse_int(p, a) || !parse_int(p, b) || !at_end(p) || b < a || b - a >= 10000 || !lunar_year_supported(a) || !lunar_year_supported(b)) return false;
+
+            out += festival_names[f];
+            char buf[32];
+            festival_year_t fy;
+            for (int y = a; y <= b; ++y) {
+                calc_festivals(years.get(y), fy);
+                snprintf(buf, sizeof(buf), "\t%d=", y);
+                out += buf;
+                if (fy.days[f] != INT_MIN) append_civil(out, fy.days[f]);
+            }
+            return true;
+        }
+
+        // 执行一行查询，结果（含换行）追加到out
+        template <class Years>
+        static bool execute(Years &years, const char *line, std::string &out) {
+            const std::size_t mark = out.size();
+            const char *p = skip_spaces(line);
+            bool ok;
+            if (strncmp(p, "g2l ", 4) == 0) ok = query_g2l(years, skip_spaces(p + 4), out);
+            else if (strncmp(p, "l2g ", 4) == 0) ok = query_l2g(years, skip_spaces(p + 4), out);
+            else if (strncmp(p, "year ", 5) == 0) ok = query_year(years, skip_spaces(p + 5), out);
+            else if (strncmp(p, "terms ", 6) == 0) ok = query_year_events(years, skip_spaces(p + 6), out, true);
+            else if (strncmp(p, "moons ", 6) == 0) ok = query_year_events(years, skip_spaces(p + 6), out, false);
+            else if (strncmp(p, "events ", 7) == 0) ok = query_events(years, skip_spaces(p + 7), out);
+            else if (strncmp(p, "festival ", 9) == 0) ok = query_festival(years, skip_spaces(p + 9), out);
+            else ok = query_g2l(years, p, out);
+
+            if (!ok) {
+                out.resize(mark);
+                out += "error\t";
+                const char *e = line + strlen(line);
+                while (e > line && (e[-1] == '\n' || e[-1] == '\r')) --e;
+                out.append(line, e);
+            }
+            out += '\n';
+            return ok;
+        }
+    }
+}
+
+#endif
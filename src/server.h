@@ -0,0 +1,294 @@
+﻿#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include "calendar.h"
+#include "query.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace calendar {
+    // 本地查询服务，协议与query.h相同：每行一个查询，每个查询回一行结果，可以连续发送多个查询
+    // 另有 stats 查询，回 stats  缓存的年数  实际计算的次数  等待他人计算的次数
+    // 地址为 unix:<路径> 或 tcp:<端口>（只监听127.0.0.1）
+    // 目前只支持POSIX套接字，Windows下各函数直接返回false
+    namespace server {
+        // 多线程共享的农历年缓存
+        // 同一年的并发请求只有第一个计算，其余等待它的结果；已算的年不淘汰，返回的引用一直有效
+        // 最多缓存capacity年，默认为支持的年份范围（query::execute已拒绝范围外的年份）及前后各一年，约20MB
+        // 满了之后新的年份照算不存，结果放在本线程的OVERFLOW_SLOTS个槽中轮流使用，引用在本线程再取这么多次之前有效
+        class shared_year_cache {
+        public:
+            static constexpr std::size_t DEFAULT_CAPACITY = MAX_LUNAR_YEAR - MIN_LUNAR_YEAR + 3;
+            static constexpr std::size_t OVERFLOW_SLOTS = 4;
+
+            explicit shared_year_cache(const query::options_t &opt, std::size_t capacity = DEFAULT_CAPACITY) : _opt(opt), _capacity(capacity) {
+            }
+
+            const lunar_year_t &get(int y) {
+                std::promise<lunar_year_t> promise;
+                std::shared_future<lunar_year_t> future;
+                bool owner = false, full = false;
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    auto it = _years.find(y);
+                    if (it != _years.end()) {
+                        future = it->second;
+                    }
+                    else if (_years.size() >= _capacity) {
+                        full = true;
+                    }
+                    else {
+                        future = promise.get_future().share();
+                        _years.emplace(y, future);
+                        owner = true;
+                    }
+                }
+
+                if (full) {
+                    thread_local lunar_year_t slots[OVERFLOW_SLOTS];
+                    thread_local std::size_t next = 0;
+                    lunar_year_t &ly = slots[next++ % OVERFLOW_SLOTS];
+                    calc_lunar_year(y, ly, _opt.mode, _opt.rule);
+                    ++_computed;
+                    return ly;
+                }
+                if (owner) {
+                    lunar_year_t ly;
+                    calc_lunar_year(y, ly, _opt.mode, _opt.rule);
+                    ++_computed;
+                    promise.set_value(ly);
+                }
+                else if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    ++_coalesced;
+                }
+                // 共享状态由_years中的副本持有
+                return future.get();
+            }
+
+            const timezone_rule_t &rule() const { return _opt.rule; }
+
+            std::size_t size() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return _years.size();
+            }
+
+            std::size_t computed() const { return _computed; }
+            std::size_t coalesced() const { return _coalesced; }
+
+        private:
+            query::options_t _opt;
+            std::size_t _capacity;
+            std::mutex _mutex;
+            std::unordered_map<int, std::shared_future<lunar_year_t>> _years;
+            std::atomic<std::size_t> _computed{ 0 };
+            std::atomic<std::size_t> _coalesced{ 0 };
+        };
+
+        // 执行一行查询，stats由服务自己回答
+        static void execute(shared_year_cache &cache, const char *line, std::string &out) {
+            if (strcmp(line, "stats") == 0) {
+                char buf[96];
+                snprintf(buf, sizeof(buf), "stats\t%zu\t%zu\t%zu\n", cache.size(), cache.computed(), cache.coalesced());
+                out += buf;
+            }
+            else {
+                query::execute(cache, line, out);
+            }
+        }
+
+        struct load_report_t {
+            std::size_t requests;
+            std::size_t errors;  // 回了error或连接失败
+            double seconds;
+            double p50, p99, max;  // 单个请求的往返时间，微秒
+        };
+
+#ifndef _WIN32
+        namespace detail {
+            // 解析地址并建立套接字，listen为true时绑定并监听，否则连接
+            static int open_socket(const char *address, bool listen) {
+                int fd = -1;
+                if (strncmp(address, "unix:", 5) == 0) {
+                    sockaddr_un sa{};
+                    sa.sun_family = AF_UNIX;
+                    if (strlen(address + 5) >= sizeof(sa.sun_path)) return -1;
+                    strcpy(sa.sun_path, address + 5);
+                    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                    if (fd < 0) return -1;
+                    if (listen) unlink(sa.sun_path);
+                    const int r = listen ? bind(fd, (sockaddr *)&sa, sizeof(sa)) : connect(fd, (sockaddr *)&sa, sizeof(sa));
+                    if (r != 0) {
+                        close(fd);
+                        return -1;
+                    }
+                }
+                else if (strncmp(address, "tcp:", 4) == 0) {
+                    sockaddr_in sa{};
+                    sa.sin_family = AF_INET;
+                    sa.sin_port = htons((unsigned short)atoi(address + 4));
+                    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                    fd = socket(AF_INET, SOCK_STREAM, 0);
+                    if (fd < 0) return -1;
+                    const int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    if (listen) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                    const int r = listen ? bind(fd, (sockaddr *)&sa, sizeof(sa)) : connect(fd, (sockaddr *)&sa, sizeof(sa));
+                    if (r != 0) {
+                        close(fd);
+                        return -1;
+                    }
+                }
+                else {
+                    return -1;
+                }
+
+                if (listen && ::listen(fd, 128) != 0) {
+                    close(fd);
+                    return -1;
+                }
+                return fd;
+            }
+
+            static bool send_all(int fd, const char *data, std::size_t size) {
+                while (size > 0) {
+                    const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+                    if (n <= 0) return false;
+                    data += n;
+                    size -= (std::size_t)n;
+                }
+                return true;
+            }
+
+            // 一个连接：收到的完整行逐一执行，本次收到的各行结果合并后一次发出
+            static void serve_connection(int fd, shared_year_cache &cache) {
+                std::string pending, out;
+                char buf[65536];
+                ssize_t n;
+                while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+                    pending.append(buf, (std::size_t)n);
+                    std::size_t begin = 0, end;
+                    out.clear();
+                    while ((end = pending.find('\n', begin)) != std::string::npos) {
+                        std::size_t e = end;
+                        if (e > begin && pending[e - 1] == '\r') --e;
+                        pending[e] = '\0';
+                        execute(cache, pending.c_str() + begin, out);
+                        begin = end + 1;
+                    }
+                    pending.erase(0, begin);
+                    if (!out.empty() && !send_all(fd, out.data(), out.size())) break;
+                }
+                close(fd);
+            }
+        }
+
+        // 监听address，每个连接一个线程，所有连接共用一个年缓存；只在无法监听时返回
+        static bool run(const char *address, const query::options_t &opt) {
+            signal(SIGPIPE, SIG_IGN);
+            const int listener = detail::open_socket(address, true);
+            if (listener < 0) return false;
+
+            shared_year_cache cache(opt);
+            for (;;) {
+                const int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0) continue;
+                std::thread(detail::serve_connection, fd, std::ref(cache)).detach();
+            }
+        }
+
+        // 压测：connections个连接并发，每个连接逐个发送requests个查询并等待回复
+        // 查询为first_year ~ last_year内的随机日期，九成g2l，其余为l2g与year
+        static bool run_load(const char *address, int connections, std::size_t requests, int first_year, int last_year, load_report_t &report) {
+            std::vector<std::vector<double>> latencies(connections);
+            std::atomic<std::size_t> errors{ 0 };
+
+            auto client = [&](int c) {
+                const int fd = detail::open_socket(address, false);
+                if (fd < 0) {
+                    errors += requests;
+                    return;
+                }
+                std::mt19937 rng(12345 + c);
+                std::uniform_int_distribution<int> year(first_year, last_year), month(1, 12), day(1, 28), kind(0, 19);
+                std::vector<double> &lat = latencies[c];
+                lat.reserve(requests);
+                std::string reply;
+                char query[64], buf[65536];
+
+                for (std::size_t i = 0; i < requests; ++i) {
+                    const int k = kind(rng);
+                    if (k == 0) snprintf(query, sizeof(query), "l2g %d-%.2d-%.2d\n", year(rng), month(rng), day(rng));
+                    else if (k == 1) snprintf(query, sizeof(query), "year %d\n", year(rng));
+                    else snprintf(query, sizeof(query), "g2l %d-%.2d-%.2d\n", year(rng), month(rng), day(rng));
+
+                    const auto t0 = std::chrono::steady_clock::now();
+                    if (!detail::send_all(fd, query, strlen(query))) {
+                        errors += requests - i;
+                        break;
+                    }
+                    reply.clear();
+                    ssize_t n = 0;
+                    while (reply.find('\n') == std::string::npos && (n = recv(fd, buf, sizeof(buf), 0)) > 0) reply.append(buf, (std::size_t)n);
+                    if (n < 0 || reply.empty()) {
+                        errors += requests - i;
+                        break;
+                    }
+                    lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+                    if (reply.compare(0, 6, "error\t") == 0) ++errors;
+                }
+                close(fd);
+            };
+
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int c = 0; c < connections; ++c) threads.emplace_back(client, c);
+            for (auto &t : threads) t.join();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::vector<double> all;
+            for (auto &lat : latencies) all.insert(all.end(), lat.begin(), lat.end());
+            std::sort(all.begin(), all.end());
+            auto percentile = [&all](double q) { return all.empty() ? 0.0 : all[std::min(all.size() - 1, (std::size_t)(q * all.size()))]; };
+
+            report.requests = all.size();
+            report.errors = errors;
+            report.seconds = seconds;
+            report.p50 = percentile(0.50);
+            report.p99 = percentile(0.99);
+            report.max = all.empty() ? 0.0 : all.back();
+            return !all.empty();
+        }
+#else
+        static bool run(const char *, const query::options_t &) {
+            return false;
+        }
+
+        static bool run_load(const char *, int, std::size_t, int, int, load_report_t &) {
+            return false;
+        }
+#endif
+    }
+}
+
+#endif
@@ -0,0 +1,267 @@
+﻿#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include "calendar.h"
+#include "context.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace calendar {
+    // 分片生成农历年表，各分片可在不同进程、不同机器上计算，最后合并为一个文件
+    // 文件为文本，每个农历年一行，以#开头的行为头部与结尾：
+    //   #chncal-years 1
+    //   #range <first> <last>            整个表的年份范围
+    //   #mode full|adaptive|certified
+    //   #tz <name> <since_year>:<offset秒>...
+    //   #shard <i> <N> <core_first> <core_last>    只在分片文件中出现，各行为core_first - 1 ~ core_last + 1年
+    //   年份行...
+    //   #end <行数> <FNV-1a 64>          校验其上的全部年份行
+    // 年份行：年 闰月 | 各月（[L]月=朔日，+大月 -小月，?为无法确定） | 各节气（序号=所在日）
+    // 输出只取决于参数，同一分片重算时逐字节相同，失败的分片可以单独重跑
+    // 分片文件多出的前后各一年与相邻分片重叠，合并时逐字节比对，不同版本或参数算出的分片无法混在一起
+    namespace shard {
+        static constexpr int FORMAT_VERSION = 1;
+
+        static const char *mode_name(calc_mode_t mode) {
+            return mode == CALC_FULL ? "full" : mode == CALC_ADAPTIVE ? "adaptive" : "certified";
+        }
+
+        static std::uint64_t fnv1a(const char *data, std::size_t size, std::uint64_t h = 14695981039346656037ULL) {
+            for (std::size_t i = 0; i < size; ++i) {
+                h ^= (unsigned char)data[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        // 第i片（1 ~ N）的年份范围，各片相连且不重叠
+        static void slice(int first_year, int last_year, int i, int n, int &core_first, int &core_last) {
+            const long long total = (long long)last_year - first_year + 1;
+            core_first = first_year + (int)(total * (i - 1) / n);
+            core_last = first_year + (int)(total * i / n) - 1;
+        }
+
+        static void append_civil(std::string &out, astronomy::day_number_t day) {
+            int y, m, d;
+            char buf[32];
+            astronomy::civil_from_day_number(day, &y, &m, &d);
+            snprintf(buf, sizeof(buf), "%d-%.2d-%.2d", y, m, d);
+            out += buf;
+        }
+
+        static void format_year(const lunar_year_t &ly, std::string &out) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d\t%d\t|", ly.year, ly.leap_month);
+            out += buf;
+            for (int i = 0; i < ly.month_count; ++i) {
+                const lunar_month_t &m = ly.months[i];
+                snprintf(buf, sizeof(buf), "\t%s%d=", m.leap ? "L" : "", m.month);
+                out += buf;
+                append_civil(out, m.first_day);
+                out += m.major ? '+' : '-';
+                if (m.ambiguous) out += '?';
+            }
+            out += "\t|";
+            for (int i = 0; i < ly.term_count; ++i) {
+                snprintf(buf, sizeof(buf), "\t%d=", ly.terms[i].index);
+                out += buf;
+                append_civil(out, ly.terms[i].day);
+                if (ly.terms[i].ambiguous) out += '?';
+            }
+            out += '\n';
+        }
+
+        static void format_header(std::string &out, int first_year, int last_year, calc_mode_t mode, const timezone_rule_t &rule) {
+            char buf[96];
+            snprintf(buf, sizeof(buf), "#chncal-years %d\n#range %d %d\n#mode %s\n#tz %s", FORMAT_VERSION, first_year, last_year, mode_name(mode), rule.name);
+            out += buf;
+            for (int i = 0; i < rule.count; ++i) {
+                snprintf(buf, sizeof(buf), " %d:%.6f", rule.transitions[i].since_year, (double)(rule.transitions[i].offset * 86400));
+                out += buf;
+            }
+            out += '\n';
+        }
+
+        static void format_end(std::string &out, std::size_t lines, std::uint64_t checksum) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "#end %zu %016llx\n", lines, (unsigned long long)checksum);
+            out += buf;
+        }
+
+        // 先写临时文件再改名，中途失败不会留下不完整的结果
+        static bool write_file(const std::string &path, const std::string &data) {
+            const std::string tmp = path + ".tmp";
+            FILE *fp = fopen(tmp.c_str(), "wb");
+            if (fp == nullptr) return false;
+            bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+            ok = (fclose(fp) == 0) && ok;
+            if (!ok) {
+                remove(tmp.c_str());
+                return false;
+            }
+#ifdef _WIN32
+            return MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+            return rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+        }
+
+        // 分片文件名：<prefix>.<i>-of-<N>
+        static std::string part_path(const char *prefix, int i, int n) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), ".%d-of-%d", i, n);
+            return std::string(prefix) + buf;
+        }
+
+        // n为0时生成[first_year, last_year]的完整文件，否则生成第i片，写到part_path(path, i, n)
+        static bool generate(const char *path, int first_year, int last_year, calc_mode_t mode, const timezone_rule_t &rule, int i = 0, int n = 0) {
+            if (last_year < first_year || (n != 0 && (i < 1 || i > n || n > last_year - first_year + 1))) return false;
+
+            int core_first = first_year, core_last = last_year;
+            std::string out;
+            format_header(out, first_year, last_year, mode, rule);
+            if (n != 0) {
+                slice(first_year, last_year, i, n, core_first, core_last);
+                char buf[64];
+                snprintf(buf, sizeof(buf), "#shard %d %d %d %d\n", i, n, core_first, core_last);
+                out += buf;
+            }
+
+            const int y0 = n != 0 ? core_first - 1 : core_first;
+            const int y1 = n != 0 ? core_last + 1 : core_last;
+            const std::size_t body = out.size();
+            calendar_context ctx(mode, rule, 4);
+            for (int y = y0; y <= y1; ++y) format_year(ctx.lunar_year(y), out);
+            format_end(out, (std::size_t)(y1 - y0 + 1), fnv1a(out.data() + body, out.size() - body));
+
+            return write_file(n != 0 ? part_path(path, i, n) : std::string(path), out);
+        }
+
+        // 读入的分片
+        struct part_t {
+            std::string path;
+            std::string header;  // #shard之前的头部，各片须相同
+            int first_year, last_year;
+            int index, count, core_first, core_last;
+            std::vector<std::string> lines;  // core_first - 1 ~ core_last + 1年，各含换行
+        };
+
+        static bool fail(std::string &error, const std::string &path, const char *what) {
+            error = path + ": " + what;
+            return false;
+        }
+
+        static bool read_part(const std::string &path, part_t &p, std::string &error) {
+            FILE *fp = fopen(path.c_str(), "rb");
+            if (fp == nullptr) return fail(error, path, "cannot open");
+            std::string data;
+            char chunk[65536];
+            std::size_t n;
+            while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) data.append(chunk, n);
+            fclose(fp);
+
+            p.path = path;
+            p.header.clear();
+            p.lines.clear();
+            std::uint64_t checksum = fnv1a(nullptr, 0);
+            bool shard_seen = false, end_seen = false;
+            std::size_t pos = 0;
+            while (pos < data.size()) {
+                std::size_t e = data.find('\n', pos);
+                if (e == std::string::npos) return fail(error, path, "truncated");
+                const std::string line = data.substr(pos, e + 1 - pos);
+                pos = e + 1;
+
+                if (end_seen) return fail(error, path, "data after #end");
+                if (line[0] != '#') {
+                    if (!shard_seen) return fail(error, path, "not a shard file");
+                    p.lines.push_back(line);
+                    checksum = fnv1a(line.data(), line.size(), checksum);
+                }
+                else if (line.compare(0, 7, "#shard ") == 0) {
+                    if (sscanf(line.c_str(), "#shard %d %d %d %d", &p.index, &p.count, &p.core_first, &p.core_last) != 4) return fail(error, path, "bad #shard");
+                    shard_seen = true;
+                }
+                else if (line.compare(0, 5, "#end ") == 0) {
+                    std::size_t count;
+                    unsigned long long sum;
+                    if (sscanf(line.c_str(), "#end %zu %llx", &count, &sum) != 2) return fail(error, path, "bad #end");
+                    if (count != p.lines.size() || sum != checksum) return fail(error, path, "checksum mismatch");
+                    end_seen = true;
+                }
+                else {
+                    if (shard_seen) return fail(error, path, "header after #shard");
+                    if (line.compare(0, 7, "#range ") == 0 && sscanf(line.c_str(), "#range %d %d", &p.first_year, &p.last_year) != 2) return fail(error, path, "bad #range");
+                    p.header += line;
+                }
+            }
+            if (!end_seen) return fail(error, path, "missing #end");
+            if (p.core_last < p.core_first || p.lines.size() != (std::size_t)(p.core_last - p.core_first + 3)) return fail(error, path, "wrong number of years");
+            if (p.header.compare(0, 14, "#chncal-years ") != 0 || atoi(p.header.c_str() + 14) != FORMAT_VERSION) return fail(error, path, "unsupported format");
+
+            int first, last;
+            slice(p.first_year, p.last_year, p.index, p.count, first, last);
+            if (first != p.core_first || last != p.core_last) return fail(error, path, "slice does not match #range");
+            return true;
+        }
+
+        // 合并全部分片（顺序任意）为完整文件，与不分片直接生成的结果逐字节相同
+        // 检查：头部一致，1 ~ N片各一个且首尾相接，校验和，以及相邻分片重叠的年份逐字节相同
+        static bool merge(const std::vector<std::string> &inputs, const char *path, std::string &error) {
+            if (inputs.empty()) {
+                error = "no input";
+                return false;
+            }
+            std::vector<part_t> parts(inputs.size());
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                if (!read_part(inputs[i], parts[i], error)) return false;
+            }
+            std::sort(parts.begin(), parts.end(), [](const part_t &a, const part_t &b) { return a.index < b.index; });
+
+            const int n = parts[0].count;
+            if ((int)parts.size() != n) {
+                error = "expected " + std::to_string(n) + " shards, got " + std::to_string(parts.size());
+                return false;
+            }
+            for (int i = 0; i < n; ++i) {
+                const part_t &p = parts[i];
+                if (p.header != parts[0].header || p.count != n) return fail(error, p.path, "header differs from other shards");
+                if (p.index != i + 1) return fail(error, p.path, "duplicate or missing shard");
+                if (i > 0) {
+                    const part_t &q = parts[i - 1];
+                    // q的最后一行是p的第一个核心年，p的第一行是q的最后一个核心年
+                    if (q.lines[q.lines.size() - 1] != p.lines[1] || p.lines[0] != q.lines[q.lines.size() - 2]) {
+                        error = q.path + " and " + p.path + ": overlapping years differ";
+                        return false;
+                    }
+                }
+            }
+
+            std::string out = parts[0].header;
+            const std::size_t body = out.size();
+            std::size_t count = 0;
+            for (const part_t &p : parts) {
+                for (std::size_t k = 1; k + 1 < p.lines.size(); ++k) out += p.lines[k];
+                count += p.lines.size() - 2;
+            }
+            format_end(out, count, fnv1a(out.data() + body, out.size() - body));
+            if (!write_file(path, out)) {
+                error = std::string(path) + ": cannot write";
+                return false;
+            }
+            return true;
+        }
+    }
+}
+
+#endif
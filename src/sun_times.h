@@ -0,0 +1,233 @@
+﻿#ifndef _SUN_TIMES_H_
+#define _SUN_TIMES_H_
+
+#include "calendar.h"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace calendar {
+    // 日出、日落、视正午与真太阳时
+    // 先对整个日期范围做一次星历计算：太阳视黄经用等间隔网格求和（get_sun_ecliptic_longitude_grid），每日一个节点，
+    // 连同章动、黄赤交角换算为视赤经、赤纬；各地各日的计算只在节点之间做三次插值，不再求和级数
+    // 太阳黄纬不到1角秒，略去，对日出日落的影响在0.1秒以内
+    namespace sun {
+        // 日出日落时太阳中心的高度：大气折射34′，视半径16′
+        static constexpr double RISE_SET_ALTITUDE = -50.0 / 60.0;
+
+        // 迭代到相邻两次相差不足约0.01秒为止
+        static constexpr double TIME_TOLERANCE_DAYS = 1e-7;
+        static constexpr int MAX_ITERATIONS = 8;
+
+        static constexpr double RADIAN_PER_DEGREE = M_PI / 180;
+        static constexpr double DEGREE_PER_RADIAN = 180 / M_PI;
+
+        struct location_t {
+            double longitude;  // 东经为正，度
+            double latitude;  // 北纬为正，度
+        };
+
+        enum day_status_t {
+            SUN_RISES_AND_SETS,
+            SUN_ALWAYS_UP,  // 极昼
+            SUN_ALWAYS_DOWN  // 极夜
+        };
+
+        // 一个地方日的结果，时刻均为rule所定时区的地方时儒略日
+        struct sun_day_t {
+            astronomy::day_number_t day;
+            day_status_t status;
+            astronomy::REAL noon;  // 视正午（上中天）
+            astronomy::REAL rise, set;  // 不出、不落时为NAN
+            double equation_of_time;  // 真太阳时 - 平太阳时，分钟
+        };
+
+        // 每日一个节点（TT的0时）的太阳视赤经、赤纬与赤经章动（视恒星时与平恒星时之差），单位为度
+        // 节点之间用四点拉格朗日插值，插值误差约1e-7度（赤经相当于0.0001秒）
+        class ephemeris {
+        public:
+            // 覆盖日序first ~ last各日前后一日半的UT时刻，足以包含任何时区的地方日
+            ephemeris(astronomy::day_number_t first, astronomy::day_number_t last) {
+                _first = first;
+                _last = last;
+                _t0 = (astronomy::REAL)first - 3.5;
+                const std::size_t n = (std::size_t)(last - first) + 8;
+                _ra.resize(n);
+                _dec.resize(n);
+                _eqeq.resize(n);
+                _dt.resize(n);
+
+                std::vector<double> lon(n);
+                astronomy::get_sun_ecliptic_longitude_grid(_t0, 1, n, lon.data());
+                for (std::size_t k = 0; k < n; ++k) {
+                    const astronomy::REAL jd = _t0 + (astronomy::REAL)k;
+                    astronomy::REAL dpsi, deps;
+                    astronomy::get_nutation(jd, &dpsi, &deps);
+                    const double eps = (double)(astronomy::get_mean_obliquity(jd) + deps) * RADIAN_PER_DEGREE;
+                    const double l = lon[k] * RADIAN_PER_DEGREE;
+
+                    double ra = std::atan2(std::cos(eps) * std::sin(l), std::cos(l)) * DEGREE_PER_RADIAN;
+                    // 赤经逐日展开，不在360度处跳变，才能插值
+                    if (k > 0) ra += 360 * std::floor((_ra[k - 1] - ra) / 360 + 0.5);
+                    _ra[k] = ra;
+                    _dec[k] = std::asin(std::sin(eps) * std::sin(l)) * DEGREE_PER_RADIAN;
+                    _eqeq[k] = (double)dpsi * std::cos(eps);
+                    _dt[k] = (double)astronomy::calc_delta_t(jd);
+                }
+            }
+
+            astronomy::day_number_t first() const { return _first; }
+            astronomy::day_number_t last() const { return _last; }
+
+            // UT儒略日ut时的视赤经（展开后的，不限于0~360）、赤纬与视恒星时，单位为度
+            // ut超出星历范围（插值需要前后各两个节点）时返回false
+            bool at(astronomy::REAL ut, double &ra, double &dec, double &gast) const {
+                // 范围内x0、x都是正数，取整即floor；NAN也在这里排除
+                const double n = (double)_ra.size();
+                const double x0 = (double)(ut - _t0);
+                if (!(x0 >= 0 && x0 < n)) return false;
+                const double x = x0 + _dt[(std::size_t)x0];
+                if (!(x >= 1 && x < n - 2)) return false;
+                const std::size_t i = (std::size_t)x;
+                const double f = x - i;
+
+                const double w0 = -f * (f - 1) * (f - 2) / 6, w1 = (f + 1) * (f - 1) * (f - 2) / 2;
+                const double w2 = -(f + 1) * f * (f - 2) / 2, w3 = (f + 1) * f * (f - 1) / 6;
+                ra = w0 * _ra[i - 1] + w1 * _ra[i] + w2 * _ra[i + 1] + w3 * _ra[i + 2];
+                dec = w0 * _dec[i - 1] + w1 * _dec[i] + w2 * _dec[i + 1] + w3 * _dec[i + 2];
+                const double eqeq = w0 * _eqeq[i - 1] + w1 * _eqeq[i] + w2 * _eqeq[i + 1] + w3 * _eqeq[i + 2];
+                gast = mean_sidereal_time(ut) + eqeq;
+                return true;
+            }
+
+            // 格林尼治平恒星时（IAU 1982），单位为度，不做0~360的归一化
+            // 用double计算，J2000前后三千年内舍入误差不到1e-7度
+            static double mean_sidereal_time(astronomy::REAL ut) {
+                const double d = (double)(ut - astronomy::JD2000);
+                const double t = d / 36525;
+                return 280.46061837 + 360.98564736629 * d + (0.000387933 - t / 38710000) * t * t;
+            }
+
+        private:
+            astronomy::day_number_t _first, _last;
+            astronomy::REAL _t0;  // 第一个节点，TT儒略日
+            std::vector<double> _ra, _dec, _eqeq;
+            std::vector<double> _dt;  // 各节点的ΔT，日
+        };
+
+        namespace detail {
+            // 地方时角h，-180 ~ 180度；恒星时与展开的赤经都可能远大于360度，用floor归一化
+            // ut超出星历范围时返回false
+            static bool hour_angle(const ephemeris &eph, astronomy::REAL ut, double longitude, double &h, double &dec) {
+                double ra, gast;
+                if (!eph.at(ut, ra, dec, gast)) return false;
+                h = gast + longitude - ra;
+                h -= 360 * std::floor(h / 360 + 0.5);
+                return true;
+            }
+
+            // 时角为0的UT时刻，ut为初值；时角每日约增加360度，每步不超过半日，超出星历范围时返回NAN
+            static astronomy::REAL transit(const ephemeris &eph, astronomy::REAL ut, double longitude, double &dec) {
+                for (int i = 0; i < MAX_ITERATIONS; ++i) {
+                    double h;
+                    if (!hour_angle(eph, ut, longitude, h, dec)) return NAN;
+                    const astronomy::REAL d = h / 360;
+                    ut -= d;
+                    if (std::fabs((double)d) < TIME_TOLERANCE_DAYS) break;
+                }
+                return ut;
+            }
+
+            // 高度为RISE_SET_ALTITUDE的UT时刻，ut为初值，须在[lo, hi]内求得，否则返回NAN
+            // 对sin(高度)做牛顿迭代：sin h = sinφ·sinδ + cosφ·cosδ·cos H，时角每日增加2π，赤纬的变化略去
+            // 近极地或时角近0时分母很小，一步可能跳得很远，离开[lo, hi]即放弃，不会读到星历之外
+            static astronomy::REAL rise_set(const ephemeris &eph, astronomy::REAL ut, astronomy::REAL lo, astronomy::REAL hi, double longitude,
+                double sin_phi, double cos_phi) {
+                const double target = std::sin(RISE_SET_ALTITUDE * RADIAN_PER_DEGREE);
+                for (int i = 0; i < MAX_ITERATIONS; ++i) {
+                    double h, dec;
+                    if (!hour_angle(eph, ut, longitude, h, dec)) return NAN;
+                    const double H = h * RADIAN_PER_DEGREE;
+                    dec *= RADIAN_PER_DEGREE;
+                    double sin_dec, cos_dec, sin_H, cos_H;
+                    astronomy::detail::fast_sincos(dec, sin_dec, cos_dec);
+                    astronomy::detail::fast_sincos(H, sin_H, cos_H);
+                    const double sin_h = sin_phi * sin_dec + cos_phi * cos_dec * cos_H;
+                    const double d = (sin_h - target) / (2 * M_PI * cos_phi * cos_dec * sin_H);
+                    ut += d;
+                    if (!(ut >= lo && ut <= hi)) return NAN;
+                    if (std::fabs(d) < TIME_TOLERANCE_DAYS) return ut;
+                }
+                return NAN;
+            }
+        }
+
+        // 地方日day的日出、视正午、日落，day须在eph的范围内
+        static void calc_sun_day(const ephemeris &eph, const location_t &loc, astronomy::day_number_t day, astronomy::REAL tz, sun_day_t &out) {
+            const astronomy::REAL mean_noon = (astronomy::REAL)day - loc.longitude / 360.0;
+            double dec;
+            const astronomy::REAL noon = detail::transit(eph, mean_noon, loc.longitude, dec);
+
+            out.day = day;
+            out.noon = noon + tz;
+            out.equation_of_time = (double)(mean_noon - noon) * 1440;
+            out.rise = out.set = NAN;
+            // 只在星历范围外才会出现，day不在eph的范围内
+            if (std::isnan((double)noon)) {
+                out.status = SUN_ALWAYS_DOWN;
+                return;
+            }
+
+            // 以中天时的赤纬估计半日弧，|cos H0| > 1为极昼、极夜，不迭代；否则日出在中天前、日落在中天后半日之内
+            const double phi = loc.latitude * RADIAN_PER_DEGREE, delta = dec * RADIAN_PER_DEGREE;
+            const double sin_phi = std::sin(phi), cos_phi = std::cos(phi);
+            const double c = (std::sin(RISE_SET_ALTITUDE * RADIAN_PER_DEGREE) - sin_phi * std::sin(delta)) / (cos_phi * std::cos(delta));
+            if (c < -1) {
+                out.status = SUN_ALWAYS_UP;
+                return;
+            }
+            if (c > 1) {
+                out.status = SUN_ALWAYS_DOWN;
+                return;
+            }
+
+            out.status = SUN_RISES_AND_SETS;
+            const double half = std::acos(c) * DEGREE_PER_RADIAN / 360;
+            out.rise = detail::rise_set(eph, noon - half, noon - 0.5, noon, loc.longitude, sin_phi, cos_phi) + tz;
+            out.set = detail::rise_set(eph, noon + half, noon, noon + 0.5, loc.longitude, sin_phi, cos_phi) + tz;
+        }
+
+        // 多个地点、first ~ last各日，out[i * 日数 + j]为第i个地点的第j日
+        // 所有地点共用一次星历计算；时区按各日所在的公历年取rule
+        static void calc_sun_days(const location_t *locs, std::size_t count, astronomy::day_number_t first, astronomy::day_number_t last,
+            const timezone_rule_t &rule, sun_day_t *out) {
+            if (last < first) return;
+            const ephemeris eph(first, last);
+            const std::size_t days = (std::size_t)(last - first) + 1;
+            std::vector<astronomy::REAL> tz(days);
+            for (std::size_t j = 0; j < days; ++j) {
+                int y, m, d;
+                astronomy::civil_from_day_number(first + (astronomy::day_number_t)j, &y, &m, &d);
+                tz[j] = timezone_offset(rule, y + (y < 0));
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                for (std::size_t j = 0; j < days; ++j) {
+                    calc_sun_day(eph, locs[i], first + (astronomy::day_number_t)j, tz[j], out[i * days + j]);
+                }
+            }
+        }
+
+        // UT儒略日ut在东经longitude处的真太阳时（视太阳时），以儒略日表示：整数为视正午，与地方平太阳时相差时差
+        // 可作为set_solar_day_hour_pillars的solar，按真太阳时排日柱、时柱；ut超出星历范围时返回NAN
+        static astronomy::REAL true_solar_time(const ephemeris &eph, astronomy::REAL ut, double longitude) {
+            double h, dec;
+            if (!detail::hour_angle(eph, ut, longitude, h, dec)) return NAN;
+            const astronomy::REAL mean = ut + longitude / 360.0;
+            const double mean_angle = (double)(mean - std::floor(mean + 0.5)) * 360;
+            return mean + wrap_degrees_180(h - mean_angle) / 360;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,190 @@
+﻿#ifndef _TRIG_H_
+#define _TRIG_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+// 周期项求和用的sin/cos
+// VSOP87、ELP2000的相位b + c·t可达数十万弧度，libm在大参数时要做精细的归约，且无法向量化
+// 这里用Cody–Waite三段π/2归约到[-π/4, π/4]，再以多项式同时求sin与cos，按象限选取
+// |x|不超过TRIG_REDUCTION_LIMIT时，绝对误差约为一个ulp(π/4)；更大的参数交给libm
+// GCC、Clang下另有向量版本（AVX时一次4个double，否则2个），用于低精度档的整表求和
+// 带误差界的求和（*_bounded）仍用libm，其误差界按libm的精度推导
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ASTRONOMY_NO_SIMD)
+#define ASTRONOMY_HAS_SIMD_TRIG 1
+#else
+#define ASTRONOMY_HAS_SIMD_TRIG 0
+#endif
+
+namespace astronomy {
+    namespace detail {
+        // 象限数n须小于2^25，n·P1、n·P2才是精确的
+        static constexpr double TRIG_REDUCTION_LIMIT = 5e7;
+
+        template <class T>
+        struct trig_kernel;
+
+        // P1、P2各取π/2的28位，P3为余下部分；多项式为fdlibm的极小化多项式
+        template <>
+        struct trig_kernel<double> {
+            static constexpr double TWO_OVER_PI = 6.36619772367581343075535053490057448e-1;
+            static constexpr double P1 = 1.57079632580280303955078125000e+0;
+            static constexpr double P2 = 9.92093580898245619437147979625e-10;
+            static constexpr double P3 = -1.21770517779739658088503536698e-18;
+
+            // 在[-π/4, π/4]上 sin(r) = r + r·z·S(z)，cos(r) = 1 - z/2 + z²·C(z)，z = r²
+            static double sin_poly(double r, double z) {
+                return r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+                    + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+            }
+
+            static double cos_poly(double z) {
+                return 1 - z * 0.5 + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05
+                    + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+            }
+        };
+
+        // P1、P2各取π/2的39位；多项式由泰勒级数经切比雪夫节约化得到，截断误差小于2^-67
+        template <>
+        struct trig_kernel<long double> {
+            static constexpr long double TWO_OVER_PI = 6.36619772367581343075535053490057448e-1L;
+            static constexpr long double P1 = 1.57079632679597125388681888580e+0L;
+            static constexpr long double P2 = -1.07463465549783099518756524643e-12L;
+            static constexpr long double P3 = 6.36831716351095013979281219078e-25L;
+
+            static long double sin_poly(long double r, long double z) {
+                return r + r * z * (-1.666666666666666662962655e-1L + z * (8.333333333333320721481813e-3L + z * (-1.984126984125348145639975e-4L
+                    + z * (2.755731921356371887896865e-6L + z * (-2.505210477945043794705194e-8L + z * (1.605835247077129362222404e-10L
+                    + z * -7.578092101608429870353019e-13L))))));
+            }
+
+            static long double cos_poly(long double z) {
+                return 1 - z * 0.5L + z * z * (4.166666666666666649303257e-2L + z * (-1.388888888888885998533597e-3L + z * (2.480158730156319894693108e-5L
+                    + z * (-2.755731921269469661389288e-7L + z * (2.087675388030137785731979e-9L + z * (-1.147024699775575143128336e-11L
+                    + z * 4.736306350576679011526828e-14L))))));
+            }
+        };
+
+        // x = n·π/2 + r，返回r，quadrant为n的低两位
+        template <class T>
+        static T reduce_pi_2(T x, unsigned &quadrant) {
+            typedef trig_kernel<T> K;
+            const T n = std::floor(x * K::TWO_OVER_PI + (T)0.5);
+            quadrant = (unsigned)(long long)n & 3;
+            return ((x - n * K::P1) - n * K::P2) - n * K::P3;
+        }
+
+        template <class T>
+        static void fast_sincos(T x, T &s, T &c) {
+            typedef trig_kernel<T> K;
+            if (!(std::fabs(x) < (T)TRIG_REDUCTION_LIMIT)) {
+                s = std::sin(x);
+                c = std::cos(x);
+                return;
+            }
+
+            unsigned q;
+            const T r = reduce_pi_2(x, q);
+            const T z = r * r;
+            const T ps = K::sin_poly(r, z), pc = K::cos_poly(z);
+            // 第q象限：sin依次为 ps, pc, -ps, -pc，cos依次为 pc, -ps, -pc, ps
+            const T a = (q & 1) ? pc : ps;
+            const T b = (q & 1) ? ps : pc;
+            s = (q & 2) ? -a : a;
+            c = ((q + 1) & 2) ? -b : b;
+        }
+
+        template <class T>
+        static T fast_sin(T x) {
+            T s, c;
+            fast_sincos(x, s, c);
+            return s;
+        }
+
+        template <class T>
+        static T fast_cos(T x) {
+            T s, c;
+            fast_sincos(x, s, c);
+            return c;
+        }
+
+#if ASTRONOMY_HAS_SIMD_TRIG
+#ifdef __AVX__
+        static constexpr std::size_t TRIG_SIMD_LANES = 4;
+#else
+        static constexpr std::size_t TRIG_SIMD_LANES = 2;
+#endif
+        typedef double simd_double_t __attribute__((vector_size(TRIG_SIMD_LANES * 8)));
+        typedef long long simd_int_t __attribute__((vector_size(TRIG_SIMD_LANES * 8)));
+
+        // 一组参数的sin（shift为0）或cos（shift为1），各参数须小于TRIG_REDUCTION_LIMIT
+        // 取整用加减1.5·2^52，其尾数的低位即为象限数
+        static simd_double_t simd_sin_shifted(simd_double_t x, long long shift) {
+            typedef trig_kernel<double> K;
+            const double magic = 6755399441055744.0;
+            const simd_double_t t = x * K::TWO_OVER_PI + magic;
+            const simd_double_t n = t - magic;
+            const simd_int_t q = (simd_int_t)t + shift;
+
+            const simd_double_t r = ((x - n * K::P1) - n * K::P2) - n * K::P3;
+            const simd_double_t z = r * r;
+            const simd_double_t ps = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+                + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+            const simd_double_t pc = 1 - z * 0.5 + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05
+                + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+
+            const simd_int_t odd = -(q & 1);
+            const simd_int_t sign = (q & 2) << 62;
+            const simd_int_t v = ((simd_int_t)pc & odd) | ((simd_int_t)ps & ~odd);
+            return (simd_double_t)(v ^ sign);
+        }
+#endif
+
+        // out[i] = sin(x[i])，cosine为true时为cos(x[i])
+        static inline void fast_trig_n(const double *x, std::size_t n, bool cosine, double *out) {
+            std::size_t i = 0;
+#if ASTRONOMY_HAS_SIMD_TRIG
+            for (; i + TRIG_SIMD_LANES <= n; i += TRIG_SIMD_LANES) {
+                bool in_range = true;
+                for (std::size_t k = 0; k < TRIG_SIMD_LANES; ++k) in_range = in_range && std::fabs(x[i + k]) < TRIG_REDUCTION_LIMIT;
+                if (!in_range) break;
+
+                simd_double_t xv;
+                std::memcpy(&xv, x + i, sizeof(xv));
+                xv = simd_sin_shifted(xv, cosine ? 1 : 0);
+                std::memcpy(out + i, &xv, sizeof(xv));
+            }
+#endif
+            for (; i < n; ++i) {
+                out[i] = cosine ? fast_cos(x[i]) : fast_sin(x[i]);
+            }
+        }
+
+        // Σ a[i]·sin(x[i])，cosine为true时为Σ a[i]·cos(x[i])
+        static double fast_trig_dot(const double *a, const double *x, std::size_t n, bool cosine) {
+            double v = 0;
+            std::size_t i = 0;
+#if ASTRONOMY_HAS_SIMD_TRIG
+            simd_double_t acc = {};
+            for (; i + TRIG_SIMD_LANES <= n; i += TRIG_SIMD_LANES) {
+                bool in_range = true;
+                for (std::size_t k = 0; k < TRIG_SIMD_LANES; ++k) in_range = in_range && std::fabs(x[i + k]) < TRIG_REDUCTION_LIMIT;
+                if (!in_range) break;
+
+                simd_double_t xv, av;
+                std::memcpy(&xv, x + i, sizeof(xv));
+                std::memcpy(&av, a + i, sizeof(av));
+                acc += av * simd_sin_shifted(xv, cosine ? 1 : 0);
+            }
+            for (std::size_t k = 0; k < TRIG_SIMD_LANES; ++k) v += acc[k];
+#endif
+            for (; i < n; ++i) {
+                v += a[i] * (cosine ? fast_cos(x[i]) : fast_sin(x[i]));
+            }
+            return v;
+        }
+    }
+}
+
+#endif
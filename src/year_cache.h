@@ -0,0 +1,267 @@
+﻿#ifndef _YEAR_CACHE_H_
+#define _YEAR_CACHE_H_
+
+#include "calendar.h"
+#include "incremental.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace calendar {
+    // 已算农历年的磁盘缓存，按（年，时区规则，精度档）为键
+    // 每条记录另带写入时的版本（version()），与当前版本不同的记录读取时略过，改了系数表、ΔT表或算法之后不会取到旧结果
+    // 文件只追加，每条记录以一次write写入，写入时持有文件锁，多个进程同时写不会交错
+    // 每条记录自带长度与校验和，读取时跳过不完整或损坏的记录（例如进程在追加中途被杀），再按魔数重新同步
+    namespace year_cache {
+        static constexpr std::uint32_t RECORD_MAGIC = 0x59434332;  // "YCC2"
+
+        // 算法改动而系数表不变时加一
+        static constexpr std::uint32_t CODE_VERSION = 1;
+
+        struct cached_month_t {
+            std::int32_t first_day;
+            std::uint8_t month;
+            std::uint8_t leap;
+            std::uint8_t major;
+            std::uint8_t ambiguous;
+            double jd;
+            double local;
+        };
+
+        struct cached_term_t {
+            std::int32_t day;
+            std::uint8_t index;
+            std::uint8_t ambiguous;
+            std::uint8_t reserved[2];
+            double jd;
+            double local;
+        };
+
+        struct record_t {
+            std::uint32_t magic;
+            std::uint32_t size;  // 整条记录的字节数
+            std::int32_t year;
+            std::uint32_t mode;
+            std::uint64_t rule_hash;
+            std::uint64_t version;
+            std::int32_t month_count;
+            std::int32_t leap_month;
+            std::int32_t end_day;
+            std::int32_t term_count;
+            cached_month_t months[13];
+            cached_term_t terms[26];
+            std::uint64_t checksum;  // FNV-1a 64，覆盖之前的全部字节
+        };
+
+        static std::uint64_t fnv1a(const void *data, std::size_t size, std::uint64_t h = 14695981039346656037ULL) {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+            for (std::size_t i = 0; i < size; ++i) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        // 时区规则的键只取决于各次切换，与名字无关
+        static std::uint64_t rule_hash(const timezone_rule_t &rule) {
+            std::uint64_t h = fnv1a(&rule.count, sizeof(rule.count));
+            for (int i = 0; i < rule.count; ++i) {
+                const std::int32_t since = rule.transitions[i].since_year;
+                const double offset = (double)rule.transitions[i].offset;
+                h = fnv1a(&since, sizeof(since), h);
+                h = fnv1a(&offset, sizeof(offset), h);
+            }
+            return h;
+        }
+
+        // CODE_VERSION、全部周期项系数表与ΔT表各段的指纹
+        static std::uint64_t version() {
+            std::uint64_t h = fnv1a(&CODE_VERSION, sizeof(CODE_VERSION));
+            const std::uint64_t series = incremental::series_fingerprint();
+            h = fnv1a(&series, sizeof(series), h);
+            for (const auto &s : incremental::delta_t_segments()) {
+                const std::int32_t since = s.since;
+                h = fnv1a(&since, sizeof(since), h);
+                h = fnv1a(&s.fingerprint, sizeof(s.fingerprint), h);
+            }
+            return h;
+        }
+
+        static void encode(int y, calc_mode_t mode, std::uint64_t rh, std::uint64_t version, const lunar_year_t &ly, record_t &r) {
+            std::memset(&r, 0, sizeof(r));
+            r.magic = RECORD_MAGIC;
+            r.size = sizeof(record_t);
+            r.year = y;
+            r.mode = (std::uint32_t)mode;
+            r.rule_hash = rh;
+            r.version = version;
+            r.month_count = ly.month_count;
+            r.leap_month = ly.leap_month;
+            r.end_day = ly.end_day;
+            r.term_count = ly.term_count;
+            for (int i = 0; i < ly.month_count; ++i) {
+                const lunar_month_t &m = ly.months[i];
+                r.months[i] = { m.first_day, (std::uint8_t)m.month, m.leap, m.major, m.ambiguous, (double)m.jd, (double)m.local };
+            }
+            for (int i = 0; i < ly.term_count; ++i) {
+                const solar_term_day_t &t = ly.terms[i];
+                cached_term_t &c = r.terms[i];
+                c.day = t.day;
+                c.index = (std::uint8_t)t.index;
+                c.ambiguous = t.ambiguous;
+                c.jd = (double)t.jd;
+                c.local = (double)t.local;
+            }
+            r.checksum = fnv1a(&r, offsetof(record_t, checksum));
+        }
+
+        static bool decode(const record_t &r, lunar_year_t &ly) {
+            if (r.month_count < 0 || r.month_count > 13 || r.term_count < 0 || r.term_count > 26) return false;
+            ly.year = r.year;
+            ly.month_count = r.month_count;
+            ly.leap_month = r.leap_month;
+            ly.end_day = r.end_day;
+            ly.term_count = r.term_count;
+            for (int i = 0; i < r.month_count; ++i) {
+                const cached_month_t &c = r.months[i];
+                ly.months[i] = { c.first_day, c.month, c.leap != 0, c.major != 0, c.ambiguous != 0, c.jd, c.local };
+            }
+            for (int i = 0; i < r.term_count; ++i) {
+                const cached_term_t &c = r.terms[i];
+                ly.terms[i] = { c.day, c.index, c.ambiguous != 0, c.jd, c.local };
+            }
+            return true;
+        }
+
+        class cache {
+        public:
+            explicit cache(const char *path) : _path(path), _version(version()) {
+                refresh();
+            }
+
+            // 读入其他进程在上次读取之后追加的记录
+            void refresh() {
+                FILE *fp = fopen(_path.c_str(), "rb");
+                if (fp == nullptr) return;
+
+                std::string buf;
+                char chunk[65536];
+                if (fseek(fp, (long)_offset, SEEK_SET) == 0) {
+                    std::size_t n;
+                    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) buf.append(chunk, n);
+                }
+                fclose(fp);
+
+                // 只消费完整的记录，结尾不完整的部分留待下次（可能有进程正在追加）
+                std::size_t pos = 0;
+                while (pos + sizeof(record_t) <= buf.size()) {
+                    record_t r;
+                    std::memcpy(&r, buf.data() + pos, sizeof(r));
+                    if (r.magic == RECORD_MAGIC && r.size == sizeof(record_t) && r.checksum == fnv1a(&r, offsetof(record_t, checksum))) {
+                        lunar_year_t ly;
+                        if (r.version == _version && decode(r, ly)) {
+                            _years[{ r.year, r.mode, r.rule_hash }] = ly;
+                        }
+                        pos += sizeof(record_t);
+                    }
+                    else {
+                        // 损坏的记录，逐字节找下一个魔数
+                        ++pos;
+                    }
+                }
+                _offset += pos;
+            }
+
+            bool lookup(int y, const timezone_rule_t &rule, calc_mode_t mode, lunar_year_t &ly) const {
+                auto it = _years.find({ y, (std::uint32_t)mode, rule_hash(rule) });
+                if (it == _years.end()) return false;
+                ly = it->second;
+                return true;
+            }
+
+            // 追加一条记录，失败时只影响缓存，不影响结果
+            bool store(int y, const timezone_rule_t &rule, calc_mode_t mode, const lunar_year_t &ly) {
+                const std::uint64_t rh = rule_hash(rule);
+                record_t r;
+                encode(y, mode, rh, _version, ly, r);
+                _years[{ y, (std::uint32_t)mode, rh }] = ly;
+                return append(&r, sizeof(r));
+            }
+
+            // 先查缓存，没有时再看其他进程是否已写入，仍没有则计算并追加
+            void lunar_year(int y, lunar_year_t &ly, calc_mode_t mode = CALC_FULL, const timezone_rule_t &rule = TIMEZONE_RULE_CHINA) {
+                if (lookup(y, rule, mode, ly)) return;
+                refresh();
+                if (lookup(y, rule, mode, ly)) return;
+                calc_lunar_year(y, ly, mode, rule);
+                store(y, rule, mode, ly);
+            }
+
+            std::size_t size() const { return _years.size(); }
+
+        private:
+            struct key_t {
+                std::int32_t year;
+                std::uint32_t mode;
+                std::uint64_t rule_hash;
+
+                bool operator==(const key_t &other) const {
+                    return year == other.year && mode == other.mode && rule_hash == other.rule_hash;
+                }
+            };
+
+            struct key_hash {
+                std::size_t operator()(const key_t &k) const {
+                    return (std::size_t)(k.rule_hash ^ ((std::uint64_t)(std::uint32_t)k.year * 0x9E3779B97F4A7C15ULL) ^ k.mode);
+                }
+            };
+
+#ifdef _WIN32
+            bool append(const void *data, std::size_t size) {
+                HANDLE h = CreateFileA(_path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (h == INVALID_HANDLE_VALUE) return false;
+                OVERLAPPED ov{};
+                bool ok = LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &ov) != 0;
+                if (ok) {
+                    DWORD written = 0;
+                    ok = WriteFile(h, data, (DWORD)size, &written, nullptr) != 0 && written == size;
+                    UnlockFileEx(h, 0, MAXDWORD, MAXDWORD, &ov);
+                }
+                CloseHandle(h);
+                return ok;
+            }
+#else
+            bool append(const void *data, std::size_t size) {
+                const int fd = ::open(_path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+                if (fd < 0) return false;
+                bool ok = flock(fd, LOCK_EX) == 0;
+                if (ok) {
+                    ok = ::write(fd, data, size) == (ssize_t)size;
+                    flock(fd, LOCK_UN);
+                }
+                ::close(fd);
+                return ok;
+            }
+#endif
+
+            std::string _path;
+            std::uint64_t _version;
+            std::size_t _offset = 0;  // 已读取到的位置
+            std::unordered_map<key_t, lunar_year_t, key_hash> _years;
+        };
+    }
+}
+
+#endif